@@ -0,0 +1,86 @@
+#include <float.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#ifndef PLATFORM_WEB
+#include <future>
+
+// NOTE: Computes diagrams in the background, for callers that need to stay responsive while a
+//       large diagram is built. Each job runs on its own thread with its own context, and comes
+//       back as a future for the finished diagram along with a token that other threads can use
+//       to follow its progress or cancel it. A cancelled job stops within a few thousand sites while
+//       it is preparing its sites, or before its next event once it is sweeping, and frees all of its
+//       memory (sites, context and partial diagram) before its future is ready.
+//
+//       The web build is compiled without pthread support, so it has no async API.
+struct FortuneAsyncResult
+{
+    FortuneState state;
+    bool isCancelled;
+};
+
+typedef std::shared_ptr<FortuneSweepControl> FortuneCancellationToken;
+
+struct FortuneAsyncJob
+{
+    std::future<FortuneAsyncResult> result;
+    FortuneCancellationToken token;
+};
+
+static FortuneAsyncResult RunFortuneAsyncJob(std::vector<Vector2> sites, float cutoffY, FortuneCancellationToken token)
+{
+    FortuneAsyncResult result;
+    result.isCancelled = true;
+    if(token->isCancelRequested.load())
+    {
+        return result;
+    }
+
+    FortuneContext context;
+    context.control = token.get();
+    PrepareFortuneSites(context, sites);
+    std::vector<Vector2>().swap(sites);
+    if(token->isCancelRequested.load())
+    {
+        return result;
+    }
+
+    RunFortuneSweep(context, cutoffY);
+    if(token->isCancelRequested.load())
+    {
+        return result;
+    }
+
+    // NOTE: Only the diagram itself is kept, everything else in the context is freed on return
+    result.state = std::move(context.state);
+    result.isCancelled = false;
+    token->progress.store(1.0f);
+    return result;
+}
+
+// NOTE: Starts computing the diagram of the given sites on a new thread. As with any future from
+//       std::async, destroying the job's future waits for the job to finish (so cancel it first if
+//       the result is no longer wanted). The returned state's canonicalSite maps the input sites to
+//       its sites, as with FortunesAlgorithm.
+FortuneAsyncJob SubmitFortuneJob(std::vector<Vector2> sites, float cutoffY = -FLT_MAX)
+{
+    FortuneAsyncJob job;
+    job.token = std::make_shared<FortuneSweepControl>();
+    job.result = std::async(std::launch::async, RunFortuneAsyncJob, std::move(sites), cutoffY, job.token);
+    return job;
+}
+
+// NOTE: Safe to call from any thread, any number of times, including after the job has finished
+//       (in which case it has no effect on the result).
+void CancelFortuneJob(const FortuneCancellationToken& token)
+{
+    token->isCancelRequested.store(true);
+}
+
+// NOTE: How far the job's sweep has got through the y range of its sites, from 0 to 1
+float GetFortuneJobProgress(const FortuneCancellationToken& token)
+{
+    return token->progress.load(std::memory_order_relaxed);
+}
+#endif // PLATFORM_WEB
@@ -0,0 +1,201 @@
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: The Voronoi cells of a set of sites, each clipped to a bounding rectangle.
+//       Cell i belongs to sites[i] and is the convex polygon made up of
+//       vertices[firstVertex[i]] up to (but not including) vertices[firstVertex[i+1]],
+//       in counter-clockwise order. A cell can be empty if its site lies outside the bounds.
+struct VoronoiCells
+{
+    Vector2 minCorner;
+    Vector2 maxCorner;
+    std::vector<Vector2> sites;
+    std::vector<uint32_t> firstVertex;
+    std::vector<Vector2> vertices;
+};
+
+// NOTE: Clips the convex polygon in `polygon` to the half of the plane that is closer to `site`
+//       than to `other`, writing the result into `clipped`.
+static void ClipPolygonToBisector(const std::vector<Vector2>& polygon, Vector2 site, Vector2 other, std::vector<Vector2>& clipped)
+{
+    // A point p is closer to site than to other iff dot(p - midpoint, normal) <= 0
+    Vector2 normal = {other.x - site.x, other.y - site.y};
+    Vector2 midpoint = {0.5f*(site.x + other.x), 0.5f*(site.y + other.y)};
+
+    clipped.clear();
+    size_t pointCount = polygon.size();
+    for(size_t i=0; i<pointCount; i++)
+    {
+        Vector2 current = polygon[i];
+        Vector2 next = polygon[(i+1) % pointCount];
+        float currentDist = (current.x - midpoint.x)*normal.x + (current.y - midpoint.y)*normal.y;
+        float nextDist = (next.x - midpoint.x)*normal.x + (next.y - midpoint.y)*normal.y;
+
+        if(currentDist <= 0.0f)
+        {
+            clipped.emplace_back(current);
+        }
+        if((currentDist <= 0.0f) != (nextDist <= 0.0f))
+        {
+            float t = currentDist/(currentDist - nextDist);
+            Vector2 intersection = {current.x + t*(next.x - current.x),
+                                    current.y + t*(next.y - current.y)};
+            clipped.emplace_back(intersection);
+        }
+    }
+}
+
+static void ResetCellPolygon(std::vector<Vector2>& polygon, Vector2 minCorner, Vector2 maxCorner)
+{
+    polygon.clear();
+    polygon.push_back({minCorner.x, minCorner.y});
+    polygon.push_back({maxCorner.x, minCorner.y});
+    polygon.push_back({maxCorner.x, maxCorner.y});
+    polygon.push_back({minCorner.x, maxCorner.y});
+}
+
+static float GetMaxDistanceSq(const std::vector<Vector2>& polygon, Vector2 site)
+{
+    float result = 0.0f;
+    for(Vector2 v : polygon)
+    {
+        float dx = v.x - site.x;
+        float dy = v.y - site.y;
+        result = max(result, dx*dx + dy*dy);
+    }
+    return result;
+}
+
+// NOTE: Computes every site's cell by clipping the bounding rectangle against the bisectors of
+//       nearby sites. Sites are bucketed into a uniform grid and searched in rings of grid cells
+//       around each site, stopping once the ring is further away than twice the distance to the
+//       cell's furthest vertex (no site beyond that distance can cut the cell any further).
+void BuildClippedCells(const std::vector<Vector2>& sites, Vector2 minCorner, Vector2 maxCorner, VoronoiCells& cells)
+{
+    cells.minCorner = minCorner;
+    cells.maxCorner = maxCorner;
+    cells.sites = sites;
+    cells.firstVertex.clear();
+    cells.vertices.clear();
+    if(sites.empty())
+    {
+        cells.firstVertex.emplace_back(0);
+        return;
+    }
+
+    Vector2 siteMin = sites[0];
+    Vector2 siteMax = sites[0];
+    for(Vector2 site : sites)
+    {
+        siteMin.x = min(siteMin.x, site.x);
+        siteMin.y = min(siteMin.y, site.y);
+        siteMax.x = max(siteMax.x, site.x);
+        siteMax.y = max(siteMax.y, site.y);
+    }
+    float extent = max(max(siteMax.x - siteMin.x, siteMax.y - siteMin.y), 1.0f);
+    int gridSize = (int)max(1.0f, floorf(sqrtf((float)sites.size())));
+    float bucketSize = extent/(float)gridSize;
+
+    // Counting-sort the sites into their grid buckets
+    std::vector<uint32_t> bucketStart(gridSize*gridSize + 1, 0);
+    std::vector<uint32_t> bucketSites(sites.size());
+    std::vector<uint32_t> siteBucket(sites.size());
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        int bucketX = (int)clampf((sites[i].x - siteMin.x)/bucketSize, 0.0f, (float)(gridSize-1));
+        int bucketY = (int)clampf((sites[i].y - siteMin.y)/bucketSize, 0.0f, (float)(gridSize-1));
+        siteBucket[i] = bucketY*gridSize + bucketX;
+        bucketStart[siteBucket[i] + 1]++;
+    }
+    for(int i=0; i<gridSize*gridSize; i++)
+    {
+        bucketStart[i+1] += bucketStart[i];
+    }
+    std::vector<uint32_t> bucketFill(bucketStart.begin(), bucketStart.end()-1);
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        bucketSites[bucketFill[siteBucket[i]]++] = (uint32_t)i;
+    }
+
+    std::vector<Vector2> polygon;
+    std::vector<Vector2> clipped;
+    cells.firstVertex.reserve(sites.size() + 1);
+    for(size_t siteIndex=0; siteIndex<sites.size(); siteIndex++)
+    {
+        Vector2 site = sites[siteIndex];
+        ResetCellPolygon(polygon, minCorner, maxCorner);
+
+        int centreX = (int)(siteBucket[siteIndex] % gridSize);
+        int centreY = (int)(siteBucket[siteIndex] / gridSize);
+        for(int ring=0; ring<gridSize; ring++)
+        {
+            // Every site in this ring is at least (ring-1) buckets away from the site
+            float ringDistance = (float)(ring-1)*bucketSize;
+            if(polygon.empty() || ((ringDistance > 0.0f) && (ringDistance*ringDistance >= 4.0f*GetMaxDistanceSq(polygon, site))))
+            {
+                break;
+            }
+
+            for(int bucketY=centreY-ring; bucketY<=centreY+ring; bucketY++)
+            {
+                if((bucketY < 0) || (bucketY >= gridSize)) continue;
+                bool isEdgeRow = (bucketY == centreY-ring) || (bucketY == centreY+ring);
+                int step = isEdgeRow ? 1 : 2*ring;
+                for(int bucketX=centreX-ring; bucketX<=centreX+ring; bucketX+=step)
+                {
+                    if((bucketX < 0) || (bucketX >= gridSize)) continue;
+                    int bucket = bucketY*gridSize + bucketX;
+                    for(uint32_t i=bucketStart[bucket]; i<bucketStart[bucket+1]; i++)
+                    {
+                        uint32_t otherIndex = bucketSites[i];
+                        Vector2 other = sites[otherIndex];
+                        if((otherIndex == siteIndex) || ((other.x == site.x) && (other.y == site.y)))
+                        {
+                            continue;
+                        }
+                        ClipPolygonToBisector(polygon, site, other, clipped);
+                        polygon.swap(clipped);
+                    }
+                }
+            }
+        }
+
+        cells.firstVertex.emplace_back((uint32_t)cells.vertices.size());
+        cells.vertices.insert(cells.vertices.end(), polygon.begin(), polygon.end());
+    }
+    cells.firstVertex.emplace_back((uint32_t)cells.vertices.size());
+}
+
+// NOTE: Computes every site's cell straight from the diagram. A Voronoi cell is exactly the
+//       intersection of the half-planes towards its site from the bisectors with each of its
+//       Delaunay neighbours, so no spatial search is needed once the adjacency is known.
+void BuildClippedCells(const FortuneState& state, const SiteAdjacency& adjacency, Vector2 minCorner, Vector2 maxCorner, VoronoiCells& cells)
+{
+    const std::vector<Vector2>& sites = state.sites;
+    assert(adjacency.firstNeighbour.size() == sites.size() + 1);
+    cells.minCorner = minCorner;
+    cells.maxCorner = maxCorner;
+    cells.sites = sites;
+    cells.firstVertex.clear();
+    cells.vertices.clear();
+    cells.firstVertex.reserve(sites.size() + 1);
+
+    std::vector<Vector2> polygon;
+    std::vector<Vector2> clipped;
+    for(size_t siteIndex=0; siteIndex<sites.size(); siteIndex++)
+    {
+        ResetCellPolygon(polygon, minCorner, maxCorner);
+        for(uint32_t i=adjacency.firstNeighbour[siteIndex]; i<adjacency.firstNeighbour[siteIndex+1]; i++)
+        {
+            ClipPolygonToBisector(polygon, sites[siteIndex], sites[adjacency.neighbours[i]], clipped);
+            polygon.swap(clipped);
+        }
+
+        cells.firstVertex.emplace_back((uint32_t)cells.vertices.size());
+        cells.vertices.insert(cells.vertices.end(), polygon.begin(), polygon.end());
+    }
+    cells.firstVertex.emplace_back((uint32_t)cells.vertices.size());
+}
@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+struct SiteHashEntry
+{
+    int64_t cellX;
+    int64_t cellY;
+    uint32_t site; // Index into the unique sites, or InvalidIndex for an empty slot
+};
+
+// NOTE: Far from the origin (or with a tiny epsilon) the cell index may not fit in an int64_t, so it
+//       is clamped to +/-2^62, which leaves room for the +/-1 of the neighbouring cells. Sites beyond
+//       that all share the edge cells, which only costs extra distance checks and never a missed merge.
+static int64_t GetSiteHashCellIndex(float coordinate, float epsilon)
+{
+    const double limit = 4611686018427387904.0; // 2^62
+    double cell = floor((double)coordinate/(double)epsilon);
+    if(!(cell > -limit))
+    {
+        cell = -limit;
+    }
+    else if(cell > limit)
+    {
+        cell = limit;
+    }
+    return (int64_t)cell;
+}
+
+static void GetSiteHashCell(Vector2 site, float epsilon, int64_t& cellX, int64_t& cellY)
+{
+    if(epsilon > 0.0f)
+    {
+        cellX = GetSiteHashCellIndex(site.x, epsilon);
+        cellY = GetSiteHashCellIndex(site.y, epsilon);
+    }
+    else
+    {
+        // NOTE: With no tolerance we only merge exact duplicates, so hash the exact bit patterns.
+        //       Adding 0.0f turns -0.0f into +0.0f so that the two compare equal.
+        float x = site.x + 0.0f;
+        float y = site.y + 0.0f;
+        uint32_t xBits;
+        uint32_t yBits;
+        memcpy(&xBits, &x, sizeof(xBits));
+        memcpy(&yBits, &y, sizeof(yBits));
+        cellX = xBits;
+        cellY = yBits;
+    }
+}
+
+static uint32_t HashSiteCell(int64_t cellX, int64_t cellY)
+{
+    uint64_t hash = (uint64_t)cellX*0x9E3779B97F4A7C15ull ^ (uint64_t)cellY*0xC2B2AE3D27D4EB4Full;
+    hash ^= hash >> 29;
+    return (uint32_t)hash;
+}
+
+// NOTE: Merges every site that lies within epsilon of an earlier site into that earlier site.
+//       Sites are hashed into a grid of epsilon-sized cells, so each site only needs to be compared
+//       against the sites already in its own and the 8 surrounding cells, making this linear in the
+//       number of sites. On return uniqueSites holds the remaining sites (in the order in which they
+//       first appeared) and canonicalSite[i] is the index in uniqueSites of the site that sites[i]
+//       was merged into. hashTable is only used as scratch space and can be kept between calls.
+//       sites and uniqueSites can be the same vector, since each unique site is written at or before
+//       the position it was read from. If isCancelRequested is given, it is checked every few
+//       thousand sites and once it is set this gives up and returns false, leaving both outputs
+//       incomplete.
+bool DeduplicateSites(const std::vector<Vector2>& sites, float epsilon,
+                      std::vector<Vector2>& uniqueSites, std::vector<uint32_t>& canonicalSite,
+                      std::vector<SiteHashEntry>& hashTable, const std::atomic<bool>* isCancelRequested = nullptr)
+{
+    if(&uniqueSites != &sites)
+    {
+        uniqueSites.resize(sites.size());
+    }
+    uint32_t uniqueCount = 0;
+    canonicalSite.resize(sites.size());
+
+    size_t tableSize = 16;
+    while(tableSize < 2*sites.size())
+    {
+        tableSize *= 2;
+    }
+    SiteHashEntry emptyEntry = {0, 0, InvalidIndex};
+    hashTable.assign(tableSize, emptyEntry);
+    uint32_t tableMask = (uint32_t)(tableSize - 1);
+
+    int64_t searchRadius = (epsilon > 0.0f) ? 1 : 0;
+    float epsilonSq = epsilon*epsilon;
+    for(size_t siteIndex=0; siteIndex<sites.size(); siteIndex++)
+    {
+        if((isCancelRequested != nullptr) && ((siteIndex & 4095) == 0) &&
+           isCancelRequested->load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        Vector2 site = sites[siteIndex];
+        int64_t cellX;
+        int64_t cellY;
+        GetSiteHashCell(site, epsilon, cellX, cellY);
+
+        uint32_t match = InvalidIndex;
+        for(int64_t neighbourY=cellY-searchRadius; (neighbourY<=cellY+searchRadius) && (match == InvalidIndex); neighbourY++)
+        {
+            for(int64_t neighbourX=cellX-searchRadius; (neighbourX<=cellX+searchRadius) && (match == InvalidIndex); neighbourX++)
+            {
+                uint32_t slot = HashSiteCell(neighbourX, neighbourY) & tableMask;
+                while(hashTable[slot].site != InvalidIndex)
+                {
+                    const SiteHashEntry& entry = hashTable[slot];
+                    if((entry.cellX == neighbourX) && (entry.cellY == neighbourY))
+                    {
+                        Vector2 other = uniqueSites[entry.site];
+                        float dx = other.x - site.x;
+                        float dy = other.y - site.y;
+                        if((dx*dx + dy*dy <= epsilonSq) || ((dx == 0.0f) && (dy == 0.0f)))
+                        {
+                            match = entry.site;
+                            break;
+                        }
+                    }
+                    slot = (slot + 1) & tableMask;
+                }
+            }
+        }
+
+        if(match == InvalidIndex)
+        {
+            match = uniqueCount++;
+            uniqueSites[match] = site;
+
+            uint32_t slot = HashSiteCell(cellX, cellY) & tableMask;
+            while(hashTable[slot].site != InvalidIndex)
+            {
+                slot = (slot + 1) & tableMask;
+            }
+            hashTable[slot] = {cellX, cellY, match};
+        }
+        canonicalSite[siteIndex] = match;
+    }
+    uniqueSites.resize(uniqueCount);
+    return true;
+}
@@ -0,0 +1,514 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: A diagram that sites can be added to and removed from one at a time, without recomputing
+//       the whole thing. It is stored as the Delaunay graph (each site's list of Voronoi neighbours),
+//       from which any cell can be rebuilt locally by clipping against the bisectors with its
+//       neighbours. Adding or removing a site only changes the neighbours of the sites around it:
+//         - A new site takes over part of every cell that its bisector cuts. Those cells form a
+//           connected patch around the cell that the new site lands in, so they are found by walking
+//           outwards from there, and only edges between two of them can disappear.
+//         - Removing a site hands its cell out to its neighbours, and the only edges that can appear
+//           are between two of those neighbours.
+//       Each affected cell is clipped with the same edge-site bookkeeping as smallvoronoi.cpp, and
+//       an edge between two affected sites is kept if either of their cells still has it, so the
+//       neighbour lists stay symmetric even when rounding makes the two cells disagree slightly.
+//
+//       Site ids stay valid until the site is erased, after which the id may be reused. The cell
+//       that a new site lands in is found by walking the graph, starting from a site remembered in a
+//       coarse grid over the sites (with a few sites per grid cell) so that even scattered updates
+//       only walk a few steps. RebuildDynamicDiagram recomputes everything with a full sweep (keeping
+//       the ids) and resizes that grid, for when enough has changed that starting over is worth it.
+//       Neighbour lists are in no particular order.
+const double DynamicDiagramBoundsScale = 1e6;
+
+struct DynamicCellPolygon
+{
+    std::vector<double> x; // Relative to the cell's own site
+    std::vector<double> y;
+    std::vector<uint32_t> edgeSite; // The site across the edge from vertex k to k+1, or InvalidIndex for the bounds
+};
+
+struct DynamicDiagram
+{
+    std::vector<Vector2> sites; // Indexed by site id
+    std::vector<bool> isSiteAlive;
+    std::vector<std::vector<uint32_t>> neighbours;
+    std::vector<uint32_t> freeSites;
+    uint32_t liveSiteCount = 0;
+    uint32_t lastTouchedSite = InvalidIndex;
+
+    float siteMergeEpsilon = 1e-3f; // New sites this close to an existing site are not inserted
+    Vector2 minCorner = {FLT_MAX, FLT_MAX}; // The bounds of every site that has ever been inserted
+    Vector2 maxCorner = {-FLT_MAX, -FLT_MAX};
+
+    std::vector<uint32_t> walkStartSites; // A recently touched site in each grid cell, or InvalidIndex
+    uint32_t walkStartGridWidth = 0;
+    Vector2 walkStartGridMin;
+    Vector2 walkStartGridScale; // Grid cells per unit
+
+    // Scratch space, kept between updates so that they do not need to allocate
+    DynamicCellPolygon polygons[2];
+    std::vector<uint32_t> affectedSites;
+    std::vector<uint32_t> affectedIndex; // Per site id, only meaningful where visitedStamp matches
+    std::vector<uint32_t> visitedStamp;
+    uint32_t stamp = 0;
+    std::vector<uint32_t> affectedEdgeSites; // The edge sites of each affected cell, one after another
+    std::vector<uint32_t> affectedEdgeStart;
+    std::vector<uint32_t> candidates;
+    std::vector<Vector2> liveSites;
+    std::vector<uint32_t> liveSiteIds;
+    SiteAdjacency adjacency;
+};
+
+static void ClipDynamicCellToBisector(const DynamicCellPolygon& polygon, double otherX, double otherY, uint32_t otherSite,
+                                      DynamicCellPolygon& clipped)
+{
+    double offset = 0.5*(otherX*otherX + otherY*otherY);
+    uint32_t vertexCount = (uint32_t)polygon.x.size();
+    clipped.x.clear();
+    clipped.y.clear();
+    clipped.edgeSite.clear();
+    for(uint32_t k=0; k<vertexCount; k++)
+    {
+        uint32_t next = (k+1 < vertexCount) ? (k+1) : 0;
+        double dist = polygon.x[k]*otherX + polygon.y[k]*otherY - offset;
+        double nextDist = polygon.x[next]*otherX + polygon.y[next]*otherY - offset;
+        bool isCurrentInside = (dist <= 0.0);
+        bool isNextInside = (nextDist <= 0.0);
+        if(isCurrentInside)
+        {
+            clipped.x.push_back(polygon.x[k]);
+            clipped.y.push_back(polygon.y[k]);
+            clipped.edgeSite.push_back(polygon.edgeSite[k]);
+        }
+        if(isCurrentInside != isNextInside)
+        {
+            double t = dist/(dist - nextDist);
+            clipped.x.push_back(polygon.x[k] + t*(polygon.x[next] - polygon.x[k]));
+            clipped.y.push_back(polygon.y[k] + t*(polygon.y[next] - polygon.y[k]));
+            clipped.edgeSite.push_back(isCurrentInside ? otherSite : polygon.edgeSite[k]);
+        }
+    }
+}
+
+static bool IsDynamicCellCutByBisector(const DynamicCellPolygon& polygon, double otherX, double otherY)
+{
+    double offset = 0.5*(otherX*otherX + otherY*otherY);
+    for(size_t k=0; k<polygon.x.size(); k++)
+    {
+        if(polygon.x[k]*otherX + polygon.y[k]*otherY - offset > 0.0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// NOTE: Builds the cell of `site` against the given other sites, inside a rectangle around every
+//       site that has been inserted that is DynamicDiagramBoundsScale times larger than their bounds.
+static const DynamicCellPolygon& ComputeDynamicCell(DynamicDiagram& diagram, uint32_t site,
+                                                    const uint32_t* others, size_t otherCount)
+{
+    Vector2 position = diagram.sites[site];
+    double margin = DynamicDiagramBoundsScale*std::max(1.0, (double)std::max(diagram.maxCorner.x - diagram.minCorner.x,
+                                                                             diagram.maxCorner.y - diagram.minCorner.y));
+    double cellMinX = diagram.minCorner.x - margin - position.x;
+    double cellMinY = diagram.minCorner.y - margin - position.y;
+    double cellMaxX = diagram.maxCorner.x + margin - position.x;
+    double cellMaxY = diagram.maxCorner.y + margin - position.y;
+
+    DynamicCellPolygon* cell = &diagram.polygons[0];
+    DynamicCellPolygon* clipped = &diagram.polygons[1];
+    cell->x.assign({cellMinX, cellMaxX, cellMaxX, cellMinX});
+    cell->y.assign({cellMinY, cellMinY, cellMaxY, cellMaxY});
+    cell->edgeSite.assign(4, InvalidIndex);
+    for(size_t i=0; i<otherCount; i++)
+    {
+        Vector2 other = diagram.sites[others[i]];
+        ClipDynamicCellToBisector(*cell, (double)other.x - position.x, (double)other.y - position.y, others[i], *clipped);
+        std::swap(cell, clipped);
+    }
+    return *cell;
+}
+
+static bool ContainsSite(const uint32_t* sites, size_t count, uint32_t site)
+{
+    return std::find(sites, sites + count, site) != (sites + count);
+}
+
+static bool DoesAffectedCellHaveEdge(const DynamicDiagram& diagram, uint32_t affected, uint32_t other)
+{
+    const uint32_t* edgeSites = diagram.affectedEdgeSites.data() + diagram.affectedEdgeStart[affected];
+    size_t edgeCount = diagram.affectedEdgeStart[affected+1] - diagram.affectedEdgeStart[affected];
+    return ContainsSite(edgeSites, edgeCount, other);
+}
+
+static void RecordAffectedCellEdges(DynamicDiagram& diagram, const DynamicCellPolygon& cell)
+{
+    diagram.affectedEdgeSites.insert(diagram.affectedEdgeSites.end(), cell.edgeSite.begin(), cell.edgeSite.end());
+    diagram.affectedEdgeStart.push_back((uint32_t)diagram.affectedEdgeSites.size());
+}
+
+static void BeginDynamicUpdate(DynamicDiagram& diagram)
+{
+    diagram.stamp++;
+    if(diagram.stamp == 0)
+    {
+        std::fill(diagram.visitedStamp.begin(), diagram.visitedStamp.end(), 0);
+        diagram.stamp = 1;
+    }
+    diagram.affectedSites.clear();
+    diagram.affectedEdgeSites.clear();
+    diagram.affectedEdgeStart.assign(1, 0);
+}
+
+static uint32_t AllocateDynamicSite(DynamicDiagram& diagram, Vector2 position)
+{
+    uint32_t site;
+    if(!diagram.freeSites.empty())
+    {
+        site = diagram.freeSites.back();
+        diagram.freeSites.pop_back();
+        diagram.sites[site] = position;
+        diagram.isSiteAlive[site] = true;
+        assert(diagram.neighbours[site].empty());
+    }
+    else
+    {
+        site = (uint32_t)diagram.sites.size();
+        diagram.sites.push_back(position);
+        diagram.isSiteAlive.push_back(true);
+        diagram.neighbours.emplace_back();
+        diagram.affectedIndex.push_back(0);
+        diagram.visitedStamp.push_back(0);
+    }
+    diagram.liveSiteCount++;
+    return site;
+}
+
+static float GetDynamicSiteDistanceSq(const DynamicDiagram& diagram, uint32_t site, Vector2 point)
+{
+    float dx = diagram.sites[site].x - point.x;
+    float dy = diagram.sites[site].y - point.y;
+    return dx*dx + dy*dy;
+}
+
+static uint32_t GetWalkStartCell(const DynamicDiagram& diagram, Vector2 point)
+{
+    float cellX = (point.x - diagram.walkStartGridMin.x)*diagram.walkStartGridScale.x;
+    float cellY = (point.y - diagram.walkStartGridMin.y)*diagram.walkStartGridScale.y;
+    float maxCell = (float)(diagram.walkStartGridWidth - 1);
+    return (uint32_t)clampf(cellY, 0.0f, maxCell)*diagram.walkStartGridWidth + (uint32_t)clampf(cellX, 0.0f, maxCell);
+}
+
+// NOTE: Returns the live site nearest to the point (or InvalidIndex if there are none), by the
+//       same neighbour walk as FindNearestSite.
+uint32_t FindNearestDynamicSite(const DynamicDiagram& diagram, Vector2 point)
+{
+    if(diagram.liveSiteCount == 0)
+    {
+        return InvalidIndex;
+    }
+    uint32_t current = diagram.lastTouchedSite;
+    if(diagram.walkStartGridWidth > 0)
+    {
+        uint32_t gridSite = diagram.walkStartSites[GetWalkStartCell(diagram, point)];
+        if((gridSite != InvalidIndex) && diagram.isSiteAlive[gridSite])
+        {
+            current = gridSite;
+        }
+    }
+    assert((current != InvalidIndex) && diagram.isSiteAlive[current]);
+    float currentDistSq = GetDynamicSiteDistanceSq(diagram, current, point);
+    while(true)
+    {
+        uint32_t next = current;
+        for(uint32_t neighbour : diagram.neighbours[current])
+        {
+            float neighbourDistSq = GetDynamicSiteDistanceSq(diagram, neighbour, point);
+            if(neighbourDistSq < currentDistSq)
+            {
+                currentDistSq = neighbourDistSq;
+                next = neighbour;
+            }
+        }
+        if(next == current)
+        {
+            return current;
+        }
+        current = next;
+    }
+}
+
+// NOTE: Writes the cell of a live site as a counter-clockwise polygon. The cells of sites on the
+//       outside of the diagram are unbounded, and are cut off far outside of every site's bounds.
+void GetDynamicCellPolygon(DynamicDiagram& diagram, uint32_t site, std::vector<Vector2>& polygon)
+{
+    assert(diagram.isSiteAlive[site]);
+    const std::vector<uint32_t>& siteNeighbours = diagram.neighbours[site];
+    const DynamicCellPolygon& cell = ComputeDynamicCell(diagram, site, siteNeighbours.data(), siteNeighbours.size());
+    Vector2 position = diagram.sites[site];
+    polygon.resize(cell.x.size());
+    for(size_t k=0; k<cell.x.size(); k++)
+    {
+        polygon[k] = {(float)(cell.x[k] + position.x), (float)(cell.y[k] + position.y)};
+    }
+}
+
+// NOTE: Returns the id of the new site, or InvalidIndex if it was within siteMergeEpsilon of an
+//       existing site (in which case nothing changes, just as DeduplicateSites would have merged it).
+uint32_t InsertDynamicSite(DynamicDiagram& diagram, Vector2 position)
+{
+    uint32_t nearest = FindNearestDynamicSite(diagram, position);
+    if(nearest != InvalidIndex)
+    {
+        float epsilonSq = diagram.siteMergeEpsilon*diagram.siteMergeEpsilon;
+        float distSq = GetDynamicSiteDistanceSq(diagram, nearest, position);
+        if((distSq <= epsilonSq) || (distSq == 0.0f))
+        {
+            return InvalidIndex;
+        }
+    }
+    diagram.minCorner = {min(diagram.minCorner.x, position.x), min(diagram.minCorner.y, position.y)};
+    diagram.maxCorner = {max(diagram.maxCorner.x, position.x), max(diagram.maxCorner.y, position.y)};
+    uint32_t newSite = AllocateDynamicSite(diagram, position);
+    diagram.lastTouchedSite = newSite;
+    if(diagram.walkStartGridWidth > 0)
+    {
+        diagram.walkStartSites[GetWalkStartCell(diagram, position)] = newSite;
+    }
+    if(nearest == InvalidIndex)
+    {
+        return newSite;
+    }
+
+    // NOTE: Walk outwards from the cell that the new site is in. Every visited site is queued, but
+    //       only the ones whose cell is actually cut by the new bisector are affected, and only their
+    //       neighbours are visited in turn. The queue is walked in place and compacted down to just
+    //       the affected sites as we go.
+    BeginDynamicUpdate(diagram);
+    std::vector<uint32_t>& affected = diagram.affectedSites;
+    affected.push_back(nearest);
+    diagram.visitedStamp[nearest] = diagram.stamp;
+    uint32_t affectedCount = 0;
+    for(size_t i=0; i<affected.size(); i++)
+    {
+        uint32_t site = affected[i];
+        const std::vector<uint32_t>& siteNeighbours = diagram.neighbours[site];
+        const DynamicCellPolygon& cell = ComputeDynamicCell(diagram, site, siteNeighbours.data(), siteNeighbours.size());
+        double offsetX = (double)position.x - diagram.sites[site].x;
+        double offsetY = (double)position.y - diagram.sites[site].y;
+        if(!IsDynamicCellCutByBisector(cell, offsetX, offsetY))
+        {
+            continue;
+        }
+
+        DynamicCellPolygon& clipped = (&cell == &diagram.polygons[0]) ? diagram.polygons[1] : diagram.polygons[0];
+        ClipDynamicCellToBisector(cell, offsetX, offsetY, newSite, clipped);
+        RecordAffectedCellEdges(diagram, clipped);
+        diagram.affectedIndex[site] = affectedCount;
+        affected[affectedCount++] = site;
+
+        for(uint32_t neighbour : siteNeighbours)
+        {
+            if(diagram.visitedStamp[neighbour] != diagram.stamp)
+            {
+                diagram.visitedStamp[neighbour] = diagram.stamp;
+                affected.push_back(neighbour);
+            }
+        }
+    }
+    affected.resize(affectedCount);
+
+    // NOTE: Sites that were visited but not affected still have visitedStamp set, so only check
+    //       affectedIndex against the compacted list.
+    for(uint32_t i=0; i<affectedCount; i++)
+    {
+        uint32_t site = affected[i];
+        std::vector<uint32_t>& siteNeighbours = diagram.neighbours[site];
+        size_t keptCount = 0;
+        for(uint32_t neighbour : siteNeighbours)
+        {
+            uint32_t neighbourIndex = diagram.affectedIndex[neighbour];
+            bool isNeighbourAffected = (diagram.visitedStamp[neighbour] == diagram.stamp) &&
+                                       (neighbourIndex < affectedCount) && (affected[neighbourIndex] == neighbour);
+            if(!isNeighbourAffected ||
+               DoesAffectedCellHaveEdge(diagram, i, neighbour) ||
+               DoesAffectedCellHaveEdge(diagram, neighbourIndex, site))
+            {
+                siteNeighbours[keptCount++] = neighbour;
+            }
+        }
+        siteNeighbours.resize(keptCount);
+        siteNeighbours.push_back(newSite);
+    }
+    diagram.neighbours[newSite].assign(affected.begin(), affected.end());
+    return newSite;
+}
+
+void EraseDynamicSite(DynamicDiagram& diagram, uint32_t site)
+{
+    assert(diagram.isSiteAlive[site]);
+    BeginDynamicUpdate(diagram);
+    std::vector<uint32_t>& affected = diagram.affectedSites;
+    affected.swap(diagram.neighbours[site]);
+    uint32_t affectedCount = (uint32_t)affected.size();
+    for(uint32_t i=0; i<affectedCount; i++)
+    {
+        diagram.visitedStamp[affected[i]] = diagram.stamp;
+        diagram.affectedIndex[affected[i]] = i;
+    }
+
+    // NOTE: Each neighbour's new cell is bounded by its other neighbours and (possibly) the rest
+    //       of the erased site's neighbours, since those are the only sites that the freed-up space
+    //       can be closer to.
+    for(uint32_t i=0; i<affectedCount; i++)
+    {
+        uint32_t neighbour = affected[i];
+        diagram.candidates.clear();
+        for(uint32_t other : diagram.neighbours[neighbour])
+        {
+            if((other != site) && (diagram.visitedStamp[other] != diagram.stamp))
+            {
+                diagram.candidates.push_back(other);
+            }
+        }
+        for(uint32_t other : affected)
+        {
+            if(other != neighbour)
+            {
+                diagram.candidates.push_back(other);
+            }
+        }
+        const DynamicCellPolygon& cell = ComputeDynamicCell(diagram, neighbour, diagram.candidates.data(),
+                                                            diagram.candidates.size());
+        RecordAffectedCellEdges(diagram, cell);
+    }
+
+    for(uint32_t i=0; i<affectedCount; i++)
+    {
+        uint32_t neighbour = affected[i];
+        std::vector<uint32_t>& neighbourNeighbours = diagram.neighbours[neighbour];
+        neighbourNeighbours.erase(std::find(neighbourNeighbours.begin(), neighbourNeighbours.end(), site));
+        for(uint32_t j=0; j<affectedCount; j++)
+        {
+            uint32_t other = affected[j];
+            if((other == neighbour) || ContainsSite(neighbourNeighbours.data(), neighbourNeighbours.size(), other))
+            {
+                continue;
+            }
+            if(DoesAffectedCellHaveEdge(diagram, i, other) || DoesAffectedCellHaveEdge(diagram, j, neighbour))
+            {
+                neighbourNeighbours.push_back(other);
+            }
+        }
+    }
+
+    uint32_t survivingNeighbour = (affectedCount > 0) ? affected[0] : InvalidIndex;
+    affected.clear();
+    diagram.neighbours[site].clear();
+    diagram.isSiteAlive[site] = false;
+    diagram.freeSites.push_back(site);
+    diagram.liveSiteCount--;
+    if(diagram.lastTouchedSite == site)
+    {
+        diagram.lastTouchedSite = survivingNeighbour;
+    }
+    if(diagram.walkStartGridWidth > 0)
+    {
+        uint32_t& gridSite = diagram.walkStartSites[GetWalkStartCell(diagram, diagram.sites[site])];
+        if(gridSite == site)
+        {
+            gridSite = survivingNeighbour;
+        }
+    }
+}
+
+// NOTE: Replaces the neighbours of each site in liveSiteIds with those of the matching site of a
+//       complete diagram, via its Delaunay adjacency.
+static void LoadDynamicNeighbours(DynamicDiagram& diagram, const FortuneState& state)
+{
+    assert(state.sites.size() == diagram.liveSiteIds.size());
+    BuildSiteAdjacency(state, diagram.adjacency);
+    for(uint32_t i=0; i<diagram.liveSiteIds.size(); i++)
+    {
+        std::vector<uint32_t>& siteNeighbours = diagram.neighbours[diagram.liveSiteIds[i]];
+        siteNeighbours.clear();
+        for(uint32_t j=diagram.adjacency.firstNeighbour[i]; j<diagram.adjacency.firstNeighbour[i+1]; j++)
+        {
+            siteNeighbours.push_back(diagram.liveSiteIds[diagram.adjacency.neighbours[j]]);
+        }
+    }
+
+    // NOTE: Aim for about four sites per grid cell, assuming that they are spread out evenly
+    uint32_t gridWidth = (uint32_t)sqrtf((float)diagram.liveSiteIds.size()/4.0f);
+    diagram.walkStartGridWidth = std::max(gridWidth, 1u);
+    diagram.walkStartGridMin = diagram.minCorner;
+    diagram.walkStartGridScale = {(float)diagram.walkStartGridWidth/max(diagram.maxCorner.x - diagram.minCorner.x, 1e-6f),
+                                  (float)diagram.walkStartGridWidth/max(diagram.maxCorner.y - diagram.minCorner.y, 1e-6f)};
+    diagram.walkStartSites.assign(diagram.walkStartGridWidth*diagram.walkStartGridWidth, InvalidIndex);
+    for(uint32_t site : diagram.liveSiteIds)
+    {
+        diagram.walkStartSites[GetWalkStartCell(diagram, diagram.sites[site])] = site;
+    }
+}
+
+// NOTE: Recomputes every neighbour list from scratch with a full sweep over the live sites, which
+//       keeps all of the site ids. The context is only used for the sweep, and has its locality
+//       reordering switched off so that the swept sites stay in the order that they were passed in.
+void RebuildDynamicDiagram(DynamicDiagram& diagram, FortuneContext& context)
+{
+    TRACE_SCOPE("Rebuild dynamic diagram");
+    diagram.liveSites.clear();
+    diagram.liveSiteIds.clear();
+    for(uint32_t site=0; site<diagram.sites.size(); site++)
+    {
+        if(diagram.isSiteAlive[site])
+        {
+            diagram.liveSites.push_back(diagram.sites[site]);
+            diagram.liveSiteIds.push_back(site);
+        }
+    }
+
+    // NOTE: Inserting already refuses sites within siteMergeEpsilon of each other, so the sweep
+    //       will not merge any of them and its sites line up with the live sites one to one.
+    context.siteMergeEpsilon = diagram.siteMergeEpsilon;
+    context.reorderForLocality = false;
+    LoadDynamicNeighbours(diagram, FortunesAlgorithm(context, diagram.liveSites, -FLT_MAX));
+}
+
+// NOTE: Starts the diagram over from a full sweep of the given sites. Duplicates are merged as
+//       usual, and each site's id is its index in the swept FortuneState::sites, so
+//       context.state.canonicalSite maps each input site to its id.
+void InitialiseDynamicDiagram(DynamicDiagram& diagram, FortuneContext& context, const std::vector<Vector2>& sites)
+{
+    TRACE_SCOPE("Initialise dynamic diagram");
+    context.siteMergeEpsilon = diagram.siteMergeEpsilon;
+    const FortuneState& state = FortunesAlgorithm(context, sites, -FLT_MAX);
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    diagram.sites = state.sites;
+    diagram.isSiteAlive.assign(siteCount, true);
+    diagram.neighbours.resize(siteCount);
+    diagram.freeSites.clear();
+    diagram.liveSiteCount = siteCount;
+    diagram.lastTouchedSite = (siteCount > 0) ? 0 : InvalidIndex;
+    diagram.affectedIndex.assign(siteCount, 0);
+    diagram.visitedStamp.assign(siteCount, 0);
+    diagram.stamp = 0;
+    diagram.minCorner = {FLT_MAX, FLT_MAX};
+    diagram.maxCorner = {-FLT_MAX, -FLT_MAX};
+    diagram.liveSiteIds.resize(siteCount);
+    for(uint32_t site=0; site<siteCount; site++)
+    {
+        Vector2 position = state.sites[site];
+        diagram.minCorner = {min(diagram.minCorner.x, position.x), min(diagram.minCorner.y, position.y)};
+        diagram.maxCorner = {max(diagram.maxCorner.x, position.x), max(diagram.maxCorner.y, position.y)};
+        diagram.liveSiteIds[site] = site;
+    }
+    LoadDynamicNeighbours(diagram, state);
+}
@@ -0,0 +1,406 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// NOTE: A compact byte encoding of a finished diagram, for sending it somewhere rather than for
+//       computing with it. Positions are quantised to a grid of the given step and written as
+//       differences from a nearby position that the decoder already knows, and every integer is
+//       zigzag (for signed values) and varint packed, so small differences take a single byte.
+//         - Sites are written in order, each relative to the previous one.
+//         - Edges are written in order, each as its lower site relative to the previous edge's lower
+//           site and its other site relative to that. Vertices are not written up front: each edge
+//           endpoint either refers back to an already-written vertex by how far back it was written,
+//           or introduces a new vertex relative to the midpoint of the edge's two sites.
+//       Both directions are a single pass over the data. Vertices come out of the decoder in the
+//       order that the edges first reach them (and vertices that no edge refers to are dropped).
+//       All of the differences are much smaller for diagrams that have been reordered for locality
+//       (see locality.cpp), which encode to less than half the size of ones in sweep order.
+struct DiagramQuantiser
+{
+    float originX;
+    float originY;
+    float step;
+};
+
+static void WriteVarint(std::vector<uint8_t>& output, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        output.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back((uint8_t)value);
+}
+
+static void WriteSignedVarint(std::vector<uint8_t>& output, int64_t value)
+{
+    WriteVarint(output, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void WriteFloat(std::vector<uint8_t>& output, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for(int i=0; i<4; i++)
+    {
+        output.push_back((uint8_t)(bits >> (8*i)));
+    }
+}
+
+struct DiagramReader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool isValid;
+};
+
+static uint64_t ReadVarint(DiagramReader& reader)
+{
+    uint64_t result = 0;
+    for(uint32_t shift=0; shift<64; shift+=7)
+    {
+        if(reader.offset >= reader.size)
+        {
+            reader.isValid = false;
+            return 0;
+        }
+        uint8_t byte = reader.data[reader.offset++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+        {
+            return result;
+        }
+    }
+    reader.isValid = false;
+    return 0;
+}
+
+static int64_t ReadSignedVarint(DiagramReader& reader)
+{
+    uint64_t value = ReadVarint(reader);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static float ReadFloat(DiagramReader& reader)
+{
+    if(reader.offset + 4 > reader.size)
+    {
+        reader.isValid = false;
+        return 0.0f;
+    }
+    uint32_t bits = 0;
+    for(int i=0; i<4; i++)
+    {
+        bits |= (uint32_t)reader.data[reader.offset++] << (8*i);
+    }
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static int64_t QuantiseCoordinate(float value, float origin, float step)
+{
+    return (int64_t)llround(((double)value - origin)/step);
+}
+
+static float DequantiseCoordinate(int64_t value, float origin, float step)
+{
+    return (float)((double)origin + (double)value*step);
+}
+
+// NOTE: Each edge starts with a single header byte that holds everything about it that usually
+//       has only a handful of possible values, with the rest following as varints:
+//         - Bits 0-1: its lower site is the same as the previous edge's, one more, or a varint
+//           difference from it follows.
+//         - Bit 2: set if its left site is the higher of the two.
+//         - Bits 3-4 and 5-6: how vertexA and vertexB are given. Either missing, a new vertex, the
+//           most recently written vertex, or a varint for how many vertices before that it was.
+//       The difference between the two sites always follows the header, and then any of the above
+//       that did not fit, in that order.
+const uint8_t EncodedSameLowSite = 0;
+const uint8_t EncodedNextLowSite = 1;
+const uint8_t EncodedLowSiteDelta = 2;
+const uint8_t EncodedLeftSiteIsHighFlag = 1 << 2;
+const uint8_t EncodedMissingVertex = 0;
+const uint8_t EncodedNewVertex = 1;
+const uint8_t EncodedLatestVertex = 2;
+const uint8_t EncodedEarlierVertex = 3;
+const uint32_t EncodedVertexAShift = 3;
+const uint32_t EncodedVertexBShift = 5;
+
+// NOTE: A new vertex lies on the bisector of its edge's two sites, so it is given in a frame around
+//       the midpoint of the (quantised) sites, with `along` measured along the bisector and `across`
+//       measured towards the higher site. `across` is only ever non-zero because of quantisation, so
+//       it is almost always -1, 0 or 1 and is packed into the bottom two bits of `along`, with 3
+//       meaning that it did not fit and follows separately. The decoded vertex is within half a
+//       grid step of the original in each direction of this frame, rather than on the grid itself.
+struct BisectorFrame
+{
+    double midX;
+    double midY;
+    double alongX;
+    double alongY;
+};
+
+static BisectorFrame GetBisectorFrame(int64_t lowX, int64_t lowY, int64_t highX, int64_t highY)
+{
+    BisectorFrame result;
+    result.midX = 0.5*(double)(lowX + highX);
+    result.midY = 0.5*(double)(lowY + highY);
+    double acrossX = (double)(highX - lowX);
+    double acrossY = (double)(highY - lowY);
+    double length = sqrt(acrossX*acrossX + acrossY*acrossY);
+    if(length > 0.0)
+    {
+        result.alongX = -acrossY/length;
+        result.alongY = acrossX/length;
+    }
+    else
+    {
+        // NOTE: Only possible with an edge between a site and (a copy of) itself, as in a periodic diagram
+        result.alongX = 1.0;
+        result.alongY = 0.0;
+    }
+    return result;
+}
+
+static void WriteBisectorVertex(std::vector<uint8_t>& output, const BisectorFrame& frame, double x, double y)
+{
+    double offsetX = x - frame.midX;
+    double offsetY = y - frame.midY;
+    int64_t along = (int64_t)llround(offsetX*frame.alongX + offsetY*frame.alongY);
+    int64_t across = (int64_t)llround(offsetX*frame.alongY - offsetY*frame.alongX);
+    uint64_t zigzagAlong = ((uint64_t)along << 1) ^ (uint64_t)(along >> 63);
+    if((across >= -1) && (across <= 1))
+    {
+        WriteVarint(output, (zigzagAlong << 2) | (uint64_t)(across + 1));
+    }
+    else
+    {
+        WriteVarint(output, (zigzagAlong << 2) | 3);
+        WriteSignedVarint(output, across);
+    }
+}
+
+static Vector2 ReadBisectorVertex(DiagramReader& reader, const BisectorFrame& frame, const DiagramQuantiser& quantiser)
+{
+    uint64_t code = ReadVarint(reader);
+    uint64_t zigzagAlong = code >> 2;
+    int64_t along = (int64_t)(zigzagAlong >> 1) ^ -(int64_t)(zigzagAlong & 1);
+    int64_t across = ((code & 3) == 3) ? ReadSignedVarint(reader) : ((int64_t)(code & 3) - 1);
+    double x = frame.midX + (double)along*frame.alongX + (double)across*frame.alongY;
+    double y = frame.midY + (double)along*frame.alongY - (double)across*frame.alongX;
+    return {(float)((double)quantiser.originX + x*quantiser.step), (float)((double)quantiser.originY + y*quantiser.step)};
+}
+
+static uint8_t GetEndpointClass(uint32_t vertex, const std::vector<uint32_t>& writtenIndex, uint32_t writtenVertexCount)
+{
+    if(vertex == InvalidIndex) return EncodedMissingVertex;
+    if(writtenIndex[vertex] == InvalidIndex) return EncodedNewVertex;
+    if(writtenIndex[vertex] == writtenVertexCount - 1) return EncodedLatestVertex;
+    return EncodedEarlierVertex;
+}
+
+// NOTE: Appends the encoding of a finished diagram to output. Positions are rounded to a grid of
+//       gridStep (measured from the minimum corner of the sites), so gridStep is the precision that
+//       the receiver needs. quantisedScratch and vertexScratch can be kept between calls.
+void EncodeDiagram(const FortuneState& state, float gridStep, std::vector<uint8_t>& output,
+                   std::vector<int64_t>& quantisedScratch, std::vector<uint32_t>& vertexScratch)
+{
+    TRACE_SCOPE("Encode diagram");
+    assert(gridStep > 0.0f);
+    DiagramQuantiser quantiser = {0.0f, 0.0f, gridStep};
+    if(!state.sites.empty())
+    {
+        quantiser.originX = state.sites[0].x;
+        quantiser.originY = state.sites[0].y;
+        for(Vector2 site : state.sites)
+        {
+            quantiser.originX = min(quantiser.originX, site.x);
+            quantiser.originY = min(quantiser.originY, site.y);
+        }
+    }
+    WriteVarint(output, state.sites.size());
+    WriteVarint(output, state.edges.size());
+    WriteFloat(output, quantiser.originX);
+    WriteFloat(output, quantiser.originY);
+    WriteFloat(output, quantiser.step);
+
+    // NOTE: Vertex predictions use the quantised sites, exactly as the decoder will see them
+    std::vector<int64_t>& quantisedSites = quantisedScratch;
+    quantisedSites.resize(2*state.sites.size());
+    int64_t previousX = 0;
+    int64_t previousY = 0;
+    for(size_t site=0; site<state.sites.size(); site++)
+    {
+        int64_t x = QuantiseCoordinate(state.sites[site].x, quantiser.originX, quantiser.step);
+        int64_t y = QuantiseCoordinate(state.sites[site].y, quantiser.originY, quantiser.step);
+        WriteSignedVarint(output, x - previousX);
+        WriteSignedVarint(output, y - previousY);
+        quantisedSites[2*site] = x;
+        quantisedSites[2*site + 1] = y;
+        previousX = x;
+        previousY = y;
+    }
+
+    std::vector<uint32_t>& writtenIndex = vertexScratch;
+    writtenIndex.assign(state.vertices.size(), InvalidIndex);
+    uint32_t writtenVertexCount = 0;
+    uint32_t previousLowSite = 0;
+    for(const CompleteEdge& edge : state.edges)
+    {
+        uint32_t lowSite = std::min(edge.leftSite, edge.rightSite);
+        uint32_t highSite = std::max(edge.leftSite, edge.rightSite);
+        uint8_t lowSiteClass = EncodedLowSiteDelta;
+        if(lowSite == previousLowSite) lowSiteClass = EncodedSameLowSite;
+        else if(lowSite == previousLowSite + 1) lowSiteClass = EncodedNextLowSite;
+
+        uint8_t classA = GetEndpointClass(edge.vertexA, writtenIndex, writtenVertexCount);
+        uint8_t classB = GetEndpointClass(edge.vertexB, writtenIndex, writtenVertexCount);
+        if(classA == EncodedNewVertex)
+        {
+            // NOTE: Writing vertexA makes it the latest vertex, which moves everything else one further back
+            if(edge.vertexB == edge.vertexA) classB = EncodedLatestVertex;
+            else if(classB == EncodedLatestVertex) classB = EncodedEarlierVertex;
+        }
+        uint8_t header = lowSiteClass | (uint8_t)(classA << EncodedVertexAShift) | (uint8_t)(classB << EncodedVertexBShift);
+        if(edge.leftSite != lowSite)
+        {
+            header |= EncodedLeftSiteIsHighFlag;
+        }
+        output.push_back(header);
+        WriteVarint(output, highSite - lowSite);
+        if(lowSiteClass == EncodedLowSiteDelta)
+        {
+            WriteSignedVarint(output, (int64_t)lowSite - (int64_t)previousLowSite);
+        }
+        previousLowSite = lowSite;
+
+        BisectorFrame frame = GetBisectorFrame(quantisedSites[2*lowSite], quantisedSites[2*lowSite + 1],
+                                               quantisedSites[2*highSite], quantisedSites[2*highSite + 1]);
+        uint32_t endpoints[] = {edge.vertexA, edge.vertexB};
+        uint8_t classes[] = {classA, classB};
+        for(int i=0; i<2; i++)
+        {
+            uint32_t vertex = endpoints[i];
+            if(classes[i] == EncodedNewVertex)
+            {
+                Vector2 position = state.vertices[vertex];
+                WriteBisectorVertex(output, frame, ((double)position.x - quantiser.originX)/quantiser.step,
+                                                   ((double)position.y - quantiser.originY)/quantiser.step);
+                writtenIndex[vertex] = writtenVertexCount++;
+            }
+            else if(classes[i] == EncodedEarlierVertex)
+            {
+                WriteVarint(output, writtenVertexCount - 1 - writtenIndex[vertex]);
+            }
+        }
+    }
+}
+
+// NOTE: Decodes a diagram written by EncodeDiagram into state, replacing whatever it held. The
+//       decoded state is finished (there is no beachline or pending events) and its canonicalSite
+//       is the identity. Returns false (leaving state in an unspecified but valid condition) if the
+//       data is truncated or refers to sites or vertices that do not exist.
+bool DecodeDiagram(const uint8_t* data, size_t size, FortuneState& state, std::vector<int64_t>& quantisedScratch)
+{
+    TRACE_SCOPE("Decode diagram");
+    DiagramReader reader = {data, size, 0, true};
+    uint64_t siteCount = ReadVarint(reader);
+    uint64_t edgeCount = ReadVarint(reader);
+    DiagramQuantiser quantiser;
+    quantiser.originX = ReadFloat(reader);
+    quantiser.originY = ReadFloat(reader);
+    quantiser.step = ReadFloat(reader);
+
+    state.sites.clear();
+    state.canonicalSite.clear();
+    state.vertices.clear();
+    state.edges.clear();
+    state.unencounteredEvents.clear();
+    ClearBeachline(state.beachline);
+    state.sweepY = 0.0f;
+
+    // NOTE: Each site takes at least two bytes and each edge at least two, which bounds the
+    //       counts before we allocate anything for them.
+    if(!reader.isValid || (siteCount > size/2) || (edgeCount > size/2))
+    {
+        return false;
+    }
+
+    std::vector<int64_t>& quantisedSites = quantisedScratch;
+    quantisedSites.resize(2*siteCount);
+    state.sites.resize(siteCount);
+    state.canonicalSite.resize(siteCount);
+    int64_t x = 0;
+    int64_t y = 0;
+    for(uint32_t site=0; site<siteCount; site++)
+    {
+        x += ReadSignedVarint(reader);
+        y += ReadSignedVarint(reader);
+        quantisedSites[2*site] = x;
+        quantisedSites[2*site + 1] = y;
+        state.sites[site] = {DequantiseCoordinate(x, quantiser.originX, quantiser.step),
+                             DequantiseCoordinate(y, quantiser.originY, quantiser.step)};
+        state.canonicalSite[site] = site;
+    }
+
+    state.edges.resize(edgeCount);
+    uint32_t previousLowSite = 0;
+    for(uint64_t i=0; (i<edgeCount) && reader.isValid; i++)
+    {
+        if(reader.offset >= reader.size)
+        {
+            return false;
+        }
+        uint8_t header = reader.data[reader.offset++];
+        uint8_t lowSiteClass = header & 3;
+        uint64_t siteDifference = ReadVarint(reader);
+        int64_t lowSite = (int64_t)previousLowSite;
+        if(lowSiteClass == EncodedNextLowSite) lowSite++;
+        else if(lowSiteClass == EncodedLowSiteDelta) lowSite += ReadSignedVarint(reader);
+        else if(lowSiteClass != EncodedSameLowSite) return false;
+        int64_t highSite = lowSite + (int64_t)siteDifference;
+        if((lowSite < 0) || (siteDifference >= siteCount) || (highSite >= (int64_t)siteCount))
+        {
+            return false;
+        }
+        previousLowSite = (uint32_t)lowSite;
+
+        CompleteEdge& edge = state.edges[i];
+        bool isLeftHigh = (header & EncodedLeftSiteIsHighFlag) != 0;
+        edge.leftSite = isLeftHigh ? (uint32_t)highSite : (uint32_t)lowSite;
+        edge.rightSite = isLeftHigh ? (uint32_t)lowSite : (uint32_t)highSite;
+
+        BisectorFrame frame = GetBisectorFrame(quantisedSites[2*lowSite], quantisedSites[2*lowSite + 1],
+                                               quantisedSites[2*highSite], quantisedSites[2*highSite + 1]);
+        uint32_t* endpoints[] = {&edge.vertexA, &edge.vertexB};
+        uint8_t classes[] = {(uint8_t)((header >> EncodedVertexAShift) & 3), (uint8_t)((header >> EncodedVertexBShift) & 3)};
+        for(int k=0; k<2; k++)
+        {
+            uint32_t vertexCount = (uint32_t)state.vertices.size();
+            if(classes[k] == EncodedMissingVertex)
+            {
+                *endpoints[k] = InvalidIndex;
+            }
+            else if(classes[k] == EncodedNewVertex)
+            {
+                *endpoints[k] = vertexCount;
+                state.vertices.push_back(ReadBisectorVertex(reader, frame, quantiser));
+            }
+            else
+            {
+                uint64_t distance = (classes[k] == EncodedEarlierVertex) ? ReadVarint(reader) : 0;
+                if(distance >= vertexCount)
+                {
+                    return false;
+                }
+                *endpoints[k] = (uint32_t)(vertexCount - 1 - distance);
+            }
+        }
+    }
+    return reader.isValid;
+}
@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <stdint.h>
+
+// NOTE: A fixed-size signed integer, big enough for the largest intermediate value in the
+//       integer-coordinate sweep (a little over 400 bits). Everything is done with 32-bit limbs and
+//       64-bit products so that it behaves identically on every compiler we build with, since MSVC
+//       and Emscripten do not both have a native 128-bit integer type.
+const int ExactIntLimbCount = 16;
+
+struct ExactInt
+{
+    uint32_t limbs[ExactIntLimbCount]; // The magnitude, least significant limb first
+    bool isNegative;
+};
+
+static ExactInt MakeExactInt(int64_t value)
+{
+    ExactInt result = {};
+    result.isNegative = (value < 0);
+    uint64_t magnitude = result.isNegative ? (0 - (uint64_t)value) : (uint64_t)value;
+    result.limbs[0] = (uint32_t)magnitude;
+    result.limbs[1] = (uint32_t)(magnitude >> 32);
+    return result;
+}
+
+static bool IsExactZero(const ExactInt& value)
+{
+    for(int i=0; i<ExactIntLimbCount; i++)
+    {
+        if(value.limbs[i] != 0) return false;
+    }
+    return true;
+}
+
+static int GetExactSign(const ExactInt& value)
+{
+    if(IsExactZero(value)) return 0;
+    return value.isNegative ? -1 : 1;
+}
+
+static int CompareExactMagnitude(const ExactInt& lhs, const ExactInt& rhs)
+{
+    for(int i=ExactIntLimbCount-1; i>=0; i--)
+    {
+        if(lhs.limbs[i] != rhs.limbs[i])
+        {
+            return (lhs.limbs[i] < rhs.limbs[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static void AddExactMagnitude(const ExactInt& lhs, const ExactInt& rhs, ExactInt& result)
+{
+    uint64_t carry = 0;
+    for(int i=0; i<ExactIntLimbCount; i++)
+    {
+        uint64_t sum = (uint64_t)lhs.limbs[i] + (uint64_t)rhs.limbs[i] + carry;
+        result.limbs[i] = (uint32_t)sum;
+        carry = sum >> 32;
+    }
+    assert(carry == 0);
+}
+
+// NOTE: Requires |lhs| >= |rhs|
+static void SubtractExactMagnitude(const ExactInt& lhs, const ExactInt& rhs, ExactInt& result)
+{
+    uint64_t borrow = 0;
+    for(int i=0; i<ExactIntLimbCount; i++)
+    {
+        uint64_t difference = (uint64_t)lhs.limbs[i] - (uint64_t)rhs.limbs[i] - borrow;
+        result.limbs[i] = (uint32_t)difference;
+        borrow = (difference >> 32) & 1;
+    }
+    assert(borrow == 0);
+}
+
+static ExactInt AddExact(const ExactInt& lhs, const ExactInt& rhs)
+{
+    ExactInt result = {};
+    if(lhs.isNegative == rhs.isNegative)
+    {
+        AddExactMagnitude(lhs, rhs, result);
+        result.isNegative = lhs.isNegative;
+    }
+    else if(CompareExactMagnitude(lhs, rhs) >= 0)
+    {
+        SubtractExactMagnitude(lhs, rhs, result);
+        result.isNegative = lhs.isNegative;
+    }
+    else
+    {
+        SubtractExactMagnitude(rhs, lhs, result);
+        result.isNegative = rhs.isNegative;
+    }
+    return result;
+}
+
+static ExactInt NegateExact(const ExactInt& value)
+{
+    ExactInt result = value;
+    result.isNegative = !value.isNegative;
+    return result;
+}
+
+static ExactInt SubtractExact(const ExactInt& lhs, const ExactInt& rhs)
+{
+    return AddExact(lhs, NegateExact(rhs));
+}
+
+static ExactInt MultiplyExact(const ExactInt& lhs, const ExactInt& rhs)
+{
+    ExactInt result = {};
+    result.isNegative = (lhs.isNegative != rhs.isNegative);
+    for(int i=0; i<ExactIntLimbCount; i++)
+    {
+        if(lhs.limbs[i] == 0) continue;
+        uint64_t carry = 0;
+        for(int j=0; i+j<ExactIntLimbCount; j++)
+        {
+            uint64_t product = (uint64_t)lhs.limbs[i]*(uint64_t)rhs.limbs[j] + (uint64_t)result.limbs[i+j] + carry;
+            result.limbs[i+j] = (uint32_t)product;
+            carry = product >> 32;
+        }
+        assert(carry == 0);
+    }
+    return result;
+}
+
+static int CompareExact(const ExactInt& lhs, const ExactInt& rhs)
+{
+    return GetExactSign(SubtractExact(lhs, rhs));
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: The sweep outputs sites in input order and vertices and edges in event order, so the cells
+//       around any given site end up scattered all over memory. Renumbering the sites along a
+//       Hilbert curve puts sites that are close together in space close together in memory too.
+//       Edges are then sorted by the lower of their two (new) site indices and vertices are numbered
+//       in the order that the sorted edges first reach them, so walking over the cells in order
+//       also walks over their edges and vertices in (roughly) order.
+//
+//       Each permutation maps an old index to its new index, for anything that was holding on to
+//       indices from before the reordering. canonicalSite is updated to match.
+struct FortuneReordering
+{
+    std::vector<uint32_t> newSiteIndex;
+    std::vector<uint32_t> newVertexIndex;
+    std::vector<uint32_t> newEdgeIndex;
+
+    // Scratch space, kept between calls so that reordering does not need to allocate
+    std::vector<uint64_t> sortKeys;
+    std::vector<uint32_t> edgeBucketStart;
+    std::vector<Vector2> scratchPoints;
+    std::vector<CompleteEdge> scratchEdges;
+};
+
+// NOTE: The position of (x,y) along a Hilbert curve that fills the 2^16 by 2^16 grid
+static uint32_t GetHilbertIndex(uint32_t x, uint32_t y)
+{
+    const uint32_t gridMax = 0xFFFF;
+    uint32_t result = 0;
+    for(uint32_t step=1u << 15; step>0; step >>= 1)
+    {
+        uint32_t quadrantX = (x & step) ? 1 : 0;
+        uint32_t quadrantY = (y & step) ? 1 : 0;
+        result += step*step*((3*quadrantX) ^ quadrantY);
+
+        // Rotate the quadrant so that the curve inside it runs in the standard direction
+        if(quadrantY == 0)
+        {
+            if(quadrantX == 1)
+            {
+                x = gridMax - x;
+                y = gridMax - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return result;
+}
+
+// NOTE: Only valid for a finished diagram, since the beachline and pending events of a sweep that
+//       was cut off still refer to the old indices.
+void ReorderFortuneState(FortuneState& state, FortuneReordering& reordering)
+{
+    TRACE_SCOPE("Reorder for locality");
+    assert(state.beachline.root == InvalidIndex);
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    uint32_t vertexCount = (uint32_t)state.vertices.size();
+    uint32_t edgeCount = (uint32_t)state.edges.size();
+
+    Vector2 minCorner = {FLT_MAX, FLT_MAX};
+    Vector2 maxCorner = {-FLT_MAX, -FLT_MAX};
+    for(Vector2 site : state.sites)
+    {
+        minCorner = {min(minCorner.x, site.x), min(minCorner.y, site.y)};
+        maxCorner = {max(maxCorner.x, site.x), max(maxCorner.y, site.y)};
+    }
+    float extent = max(maxCorner.x - minCorner.x, maxCorner.y - minCorner.y);
+    float scale = (extent > 0.0f) ? (65535.0f/extent) : 0.0f;
+
+    // NOTE: Each key holds the curve position in its high half and the old index in its low half,
+    //       so sorting the keys sorts by curve position and the old index comes along for free.
+    reordering.sortKeys.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        uint32_t x = (uint32_t)((state.sites[i].x - minCorner.x)*scale);
+        uint32_t y = (uint32_t)((state.sites[i].y - minCorner.y)*scale);
+        reordering.sortKeys[i] = ((uint64_t)GetHilbertIndex(std::min(x, 0xFFFFu), std::min(y, 0xFFFFu)) << 32) | i;
+    }
+    std::sort(reordering.sortKeys.begin(), reordering.sortKeys.end());
+    reordering.newSiteIndex.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        reordering.newSiteIndex[(uint32_t)reordering.sortKeys[i]] = i;
+    }
+
+    reordering.scratchPoints.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        reordering.scratchPoints[reordering.newSiteIndex[i]] = state.sites[i];
+    }
+    state.sites.swap(reordering.scratchPoints);
+    for(uint32_t& site : state.canonicalSite)
+    {
+        site = reordering.newSiteIndex[site];
+    }
+
+    // NOTE: The edges are sorted by their lower site with a counting sort, which keeps the edges of
+    //       each site in the order that the sweep produced them.
+    reordering.edgeBucketStart.assign(siteCount + 1, 0);
+    for(CompleteEdge& edge : state.edges)
+    {
+        edge.leftSite = reordering.newSiteIndex[edge.leftSite];
+        edge.rightSite = reordering.newSiteIndex[edge.rightSite];
+        reordering.edgeBucketStart[std::min(edge.leftSite, edge.rightSite) + 1]++;
+    }
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        reordering.edgeBucketStart[i+1] += reordering.edgeBucketStart[i];
+    }
+    reordering.newEdgeIndex.resize(edgeCount);
+    for(uint32_t i=0; i<edgeCount; i++)
+    {
+        const CompleteEdge& edge = state.edges[i];
+        reordering.newEdgeIndex[i] = reordering.edgeBucketStart[std::min(edge.leftSite, edge.rightSite)]++;
+    }
+
+    reordering.scratchEdges.resize(edgeCount);
+    reordering.newVertexIndex.assign(vertexCount, InvalidIndex);
+    uint32_t nextVertex = 0;
+    for(uint32_t i=0; i<edgeCount; i++)
+    {
+        reordering.scratchEdges[reordering.newEdgeIndex[i]] = state.edges[i];
+    }
+    for(uint32_t i=0; i<edgeCount; i++)
+    {
+        CompleteEdge& edge = reordering.scratchEdges[i];
+        uint32_t* endpoints[] = {&edge.vertexA, &edge.vertexB};
+        for(uint32_t* vertex : endpoints)
+        {
+            if(*vertex == InvalidIndex) continue;
+            if(reordering.newVertexIndex[*vertex] == InvalidIndex)
+            {
+                reordering.newVertexIndex[*vertex] = nextVertex++;
+            }
+            *vertex = reordering.newVertexIndex[*vertex];
+        }
+    }
+    state.edges.swap(reordering.scratchEdges);
+
+    // Vertices that no edge refers to (which only happens with degenerate input) go at the end
+    for(uint32_t i=0; i<vertexCount; i++)
+    {
+        if(reordering.newVertexIndex[i] == InvalidIndex)
+        {
+            reordering.newVertexIndex[i] = nextVertex++;
+        }
+    }
+    reordering.scratchPoints.resize(vertexCount);
+    for(uint32_t i=0; i<vertexCount; i++)
+    {
+        reordering.scratchPoints[reordering.newVertexIndex[i]] = state.vertices[i];
+    }
+    state.vertices.swap(reordering.scratchPoints);
+}
@@ -11,6 +11,19 @@
 
 #include "mathutil.cpp"
 #include "voronoi.cpp"
+#include "voronoi_exact.cpp"
+#include "cells.cpp"
+#include "raster.cpp"
+#include "pipeline.cpp"
+#include "tiles.cpp"
+#include "sitequery.cpp"
+#include "snapshot.cpp"
+#include "periodic.cpp"
+#include "dynamic.cpp"
+#include "encode.cpp"
+#include "async.cpp"
+#include "proximity.cpp"
+#include "sitefile.cpp"
 
 #ifdef PLATFORM_WEB
 #include <emscripten/emscripten.h>
@@ -28,6 +41,11 @@ struct MovingPoint
 };
 vector<MovingPoint> inputPoints;
 
+// NOTE: These persist across frames so that once the first frame has sized them,
+//       recomputing the diagram every frame does not need to allocate anything.
+vector<Vector2> fortunePoints;
+FortuneContext fortuneContext;
+
 void DrawCompleteEdge(Vector2 start, Vector2 end)
 {
     Vector2 screenSpaceStart = {start.x, screenHeight-start.y};
@@ -69,13 +87,10 @@ void DrawHorizontalLine(float worldY, Color color)
 
 void DrawParabola(Vector2 focus, float directrixY, float minX, float maxX, float maxY, Color color)
 {
-    Arc arc = {};
-    arc.focus = focus;
-
-    int pointCount = 50;
-    Vector2* curvePts = new Vector2[pointCount];
+    const int pointCount = 50;
+    Vector2 curvePts[pointCount];
 
-    if(!isfinite(GetArcYForXCoord(arc, 0.0f, directrixY)))
+    if(!isfinite(GetArcYForXCoord(focus, 0.0f, directrixY)))
     {
         Vector2 min = {focus.x - 1.0f, focus.y};
         Vector2 max = {focus.x + 1.0f, maxY};
@@ -91,7 +106,7 @@ void DrawParabola(Vector2 focus, float directrixY, float minX, float maxX, float
     for(int i=0; i<pointCount; i++)
     {
         // Change of variables from (x,y) to (w,y) for simplicity of expression
-        curvePts[i] = {x, GetArcYForXCoord(arc, x, directrixY)};
+        curvePts[i] = {x, GetArcYForXCoord(focus, x, directrixY)};
 
         // Y increases downwards in screencoords, so flip each point around the x-axis.
         // This is just so that it is closer to what we usually get/expect in mathematics.
@@ -104,89 +119,114 @@ void DrawParabola(Vector2 focus, float directrixY, float minX, float maxX, float
         DrawLineV(curvePts[i-1], curvePts[i], color);
     }
     DrawLine(0, screenHeight-(int)directrixY, screenWidth, screenHeight-(int)directrixY, WHITE);
-
-    delete[] curvePts;
 }
 
-void DrawBeachlineItem(BeachlineItem* item, float directrixY)
+void DrawBeachlineItem(const Beachline& beachline, uint32_t item, float directrixY)
 {
-    if(item == nullptr) return;
+    if(item == InvalidIndex) return;
 
     float minX = 0.0f;
     float maxX = (float)screenWidth;
-    if(item->type == BeachlineItemType::Arc)
+    if(beachline.type[item] == BeachlineItemType::Arc)
     {
         Color lineColor = WHITE;
 
-        BeachlineItem* prevItem = GetFirstParentOnTheLeft(item);
-        BeachlineItem* nextItem = GetFirstParentOnTheRight(item);
-        assert(!prevItem || (prevItem->type == BeachlineItemType::Edge));
-        assert(!nextItem || (nextItem->type == BeachlineItemType::Edge));
-        float maxY = (item->arc.focus.y + directrixY)*0.5f;
-        if(prevItem)
+        uint32_t prevItem = GetFirstParentOnTheLeft(beachline, item);
+        uint32_t nextItem = GetFirstParentOnTheRight(beachline, item);
+        assert((prevItem == InvalidIndex) || (beachline.type[prevItem] == BeachlineItemType::Edge));
+        assert((nextItem == InvalidIndex) || (beachline.type[nextItem] == BeachlineItemType::Edge));
+        Vector2 focus = beachline.point[item];
+        float maxY = (focus.y + directrixY)*0.5f;
+        if(prevItem != InvalidIndex)
         {
             Vector2 intersection;
-            bool doesIntersect = GetEdgeArcIntersectionPoint(prevItem->edge, item->arc, directrixY, intersection);
+            bool doesIntersect = GetEdgeArcIntersectionPoint(beachline.point[prevItem], beachline.direction[prevItem], focus, directrixY, intersection);
             if(doesIntersect)
             {
                 minX = clampf(intersection.x, 0.0f, (float)screenWidth);
             }
         }
-        if(nextItem)
+        if(nextItem != InvalidIndex)
         {
             Vector2 intersection;
-            bool doesIntersect = GetEdgeArcIntersectionPoint(nextItem->edge, item->arc, directrixY, intersection);
+            bool doesIntersect = GetEdgeArcIntersectionPoint(beachline.point[nextItem], beachline.direction[nextItem], focus, directrixY, intersection);
             if(doesIntersect)
             {
                 maxX = clampf(intersection.x, 0.0f, (float)screenWidth);
                 maxY = max(maxY, intersection.y);
             }
         }
-        DrawParabola(item->arc.focus, directrixY, minX, maxX, maxY, lineColor);
+        DrawParabola(focus, directrixY, minX, maxX, maxY, lineColor);
     }
-    else if(item->type == BeachlineItemType::Edge)
+    else if(beachline.type[item] == BeachlineItemType::Edge)
     {
-        BeachlineItem* prevItem = GetFirstLeafOnTheLeft(item);
-        BeachlineItem* nextItem = GetFirstLeafOnTheRight(item);
-        assert(!prevItem || (prevItem->type == BeachlineItemType::Arc));
-        assert(!nextItem || (nextItem->type == BeachlineItemType::Arc));
-        float minY = item->edge.start.y;
+        uint32_t prevItem = GetFirstLeafOnTheLeft(beachline, item);
+        uint32_t nextItem = GetFirstLeafOnTheRight(beachline, item);
+        assert((prevItem == InvalidIndex) || (beachline.type[prevItem] == BeachlineItemType::Arc));
+        assert((nextItem == InvalidIndex) || (beachline.type[nextItem] == BeachlineItemType::Arc));
+        Vector2 edgeStart = beachline.point[item];
+        Vector2 edgeDirection = beachline.direction[item];
+        float minY = edgeStart.y;
         float maxY = minY;
-        if(prevItem)
+        if(prevItem != InvalidIndex)
         {
             Vector2 intersection;
-            bool doesIntersect = GetEdgeArcIntersectionPoint(item->edge, prevItem->arc, directrixY, intersection);
+            bool doesIntersect = GetEdgeArcIntersectionPoint(edgeStart, edgeDirection, beachline.point[prevItem], directrixY, intersection);
             if(doesIntersect)
             {
                 minX = intersection.x;
                 minY = min(minY, intersection.y);
             }
         }
-        if(nextItem)
+        if(nextItem != InvalidIndex)
         {
             Vector2 intersection;
-            bool doesIntersect = GetEdgeArcIntersectionPoint(item->edge, nextItem->arc, directrixY, intersection);
+            bool doesIntersect = GetEdgeArcIntersectionPoint(edgeStart, edgeDirection, beachline.point[nextItem], directrixY, intersection);
             if(doesIntersect)
             {
                 maxX = intersection.x;
                 maxY = max(maxY, intersection.y);
             }
         }
-        DrawEdge(item->edge.start, item->edge.direction, {minX, minY}, {maxX, maxY});
+        DrawEdge(edgeStart, edgeDirection, {minX, minY}, {maxX, maxY});
     }
 
-    DrawBeachlineItem(item->left, directrixY);
-    DrawBeachlineItem(item->right, directrixY);
+    DrawBeachlineItem(beachline, beachline.left[item], directrixY);
+    DrawBeachlineItem(beachline, beachline.right[item], directrixY);
 }
 
 bool isInteractive = true;
 bool isMoving = false;
 bool shouldDrawFps = true;
+bool isCapturingTrace = false;
+int tracedFrameCount = 0;
+const char* traceFilename = "fortune_trace.json";
 #if PLATFORM_WEB
 int UpdatesTillInitComplete = 2;
 #endif // PLATFORM_WEB
 void UpdateAndRender()
 {
+    if(IsKeyPressed(KEY_P))
+    {
+        if(isCapturingTrace)
+        {
+            StopTraceCapture(traceFilename);
+            TraceLog(LOG_INFO, "Wrote a trace of the last %d frames to %s", tracedFrameCount, traceFilename);
+        }
+        else
+        {
+            StartTraceCapture(1 << 20);
+            tracedFrameCount = 0;
+        }
+        isCapturingTrace = !isCapturingTrace;
+    }
+    if(isCapturingTrace)
+    {
+        tracedFrameCount++;
+    }
+    TRACE_SCOPE("Frame");
+    TracePhases framePhases;
+
     bool shouldLog = false;
 #if PLATFORM_WEB
 
@@ -236,7 +276,8 @@ void UpdateAndRender()
     {
         TraceLog(LOG_INFO, "Collect input point data set");
     }
-    vector<Vector2> fortunePoints;
+    framePhases.Begin("Collect input point data set");
+    fortunePoints.clear();
     float dt = 1.0f/60.0f;
     for(MovingPoint& mp : inputPoints)
     {
@@ -255,12 +296,14 @@ void UpdateAndRender()
     {
         TraceLog(LOG_INFO, "Run Fortune");
     }
-    FortuneState fortune = FortunesAlgorithm(fortunePoints, worldSpaceMouseY);
+    framePhases.Begin("Run Fortune");
+    const FortuneState& fortune = FortunesAlgorithm(fortuneContext, fortunePoints, worldSpaceMouseY);
 
     if(shouldLog)
     {
         TraceLog(LOG_INFO, "Begin draw");
     }
+    framePhases.Begin("Begin draw");
     BeginDrawing();
     if(shouldDrawFps)
     {
@@ -271,6 +314,7 @@ void UpdateAndRender()
     {
         TraceLog(LOG_INFO, "Draw points");
     }
+    framePhases.Begin("Draw points");
     DrawHorizontalLine(worldSpaceMouseY, WHITE);
     Vector2 pointSize = {8, 8};
     if(inputPoints.size() > 500)
@@ -306,40 +350,54 @@ void UpdateAndRender()
     {
         TraceLog(LOG_INFO, "Draw beachline");
     }
+    framePhases.Begin("Draw beachline");
     float directrixY = worldSpaceMouseY;
-    if(isInteractive && fortune.beachlineRoot != nullptr)
+    if(isInteractive && (fortune.beachline.root != InvalidIndex))
     {
-        DrawBeachlineItem(fortune.beachlineRoot, directrixY);
+        DrawBeachlineItem(fortune.beachline, fortune.beachline.root, directrixY);
     }
 
     if(shouldLog)
     {
         TraceLog(LOG_INFO, "Draw completed edges");
     }
-    for(CompleteEdge* edge : fortune.edges)
+    framePhases.Begin("Draw completed edges");
+    // NOTE: While the sweep is still in progress, any endpoint it has not reached yet is drawn as
+    //       part of the beachline instead, so only draw open rays once the sweep has finished.
+    bool sweepFinished = (fortune.beachline.root == InvalidIndex);
+    for(const CompleteEdge& edge : fortune.edges)
     {
-        DrawCompleteEdge(edge->endpointA, edge->endpointB);
+        bool isOpen = (edge.vertexA == InvalidIndex) || (edge.vertexB == InvalidIndex);
+        if(isOpen && !sweepFinished)
+        {
+            continue;
+        }
+        Vector2 start;
+        Vector2 end;
+        GetEdgeSegment(fortune, edge, 10000.0f, start, end);
+        DrawCompleteEdge(start, end);
     }
 
     if(shouldLog)
     {
         TraceLog(LOG_INFO, "Draw events");
     }
-    for(SweepEvent* evt : fortune.unencounteredEvents)
+    framePhases.Begin("Draw events");
+    for(const SweepEvent& evt : fortune.unencounteredEvents)
     {
         Color color = WHITE;
-        if(evt->type == SweepEventType::NewPoint)
+        if(evt.type == SweepEventType::NewPoint)
         {
             color = RED;
         }
-        else if(evt->type == SweepEventType::EdgeIntersection)
+        else if(evt.type == SweepEventType::EdgeIntersection)
         {
-            if(!evt->edgeIntersect.isValid)
+            if(!evt.edgeIntersect.isValid)
                 color = GRAY;
             else
                 color = BLUE;
         }
-        DrawHorizontalLine(evt->yCoord, color);
+        DrawHorizontalLine(evt.yCoord, color);
 
     }
 
@@ -352,6 +410,7 @@ void UpdateAndRender()
         DrawText("Press W to move for a single frame", 0, textY, fontSize, WHITE); textY += fontSize;
         DrawText("Press T to toggle movement", 0, textY, fontSize, WHITE); textY += fontSize;
         DrawText("Press F to toggle drawing FPS", 0, textY, fontSize, WHITE); textY += fontSize;
+        DrawText("Press P to start/stop capturing a timing trace", 0, textY, fontSize, WHITE); textY += fontSize;
     }
     else
     {
@@ -362,25 +421,14 @@ void UpdateAndRender()
     {
         TraceLog(LOG_INFO, "End draw");
     }
+    framePhases.Begin("End draw");
     EndDrawing();
 
-    if(shouldLog)
-    {
-        TraceLog(LOG_INFO, "Cleanup");
-    }
-    DeleteBeachlineItem(fortune.beachlineRoot);
-    for(CompleteEdge* edge : fortune.edges)
-    {
-        delete edge;
-    }
-    for(SweepEvent* evt : fortune.unencounteredEvents)
-    {
-        delete evt;
-    }
     if(shouldLog)
     {
         TraceLog(LOG_INFO, "Done");
     }
+    framePhases.End();
 }
 
 int main()
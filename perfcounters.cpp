@@ -0,0 +1,265 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__) && !defined(PLATFORM_WEB)
+#define FORTUNE_PERF_COUNTERS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+// NOTE: Hardware performance counters for the parts of the sweep, for telling apart time lost to
+//       cache misses from time lost to branch mispredictions. Linux only (through perf_event_open)
+//       and off unless a SweepPerfCounters is given to the context. Everywhere else the functions
+//       here do nothing, so callers do not need to check for the platform.
+//
+//       The counters only count user-mode events on the thread that opened them, so they must be
+//       opened on the thread that runs the sweep. All of them are read with one system call at the
+//       start and end of each phase, which adds a little to each event, so the counts are accurate
+//       but wall time measured at the same time is not. Point location happens inside site events,
+//       so its counts are part of the site events' counts as well.
+enum class SweepPerfPhase : uint32_t
+{
+    Sweep, // The whole sweep, from its first event to the end of finalisation (or a small diagram)
+    SiteEvents,
+    CircleEvents,
+    PointLocation,
+    Finalisation,
+    Count
+};
+
+enum class SweepPerfCounter : uint32_t
+{
+    Cycles,
+    Instructions,
+    L1DataMisses,
+    LastLevelMisses,
+    BranchMisses,
+    Count
+};
+
+static const uint32_t SweepPerfPhaseCount = (uint32_t)SweepPerfPhase::Count;
+static const uint32_t SweepPerfCounterCount = (uint32_t)SweepPerfCounter::Count;
+
+struct SweepPerfTotals
+{
+    uint64_t count[SweepPerfCounterCount];
+    uint64_t phaseCount; // How many times the phase ran (i.e. how many events, for the event phases)
+};
+
+struct SweepPerfCounters
+{
+    bool isOpen = false;
+    bool isCounterOpen[SweepPerfCounterCount] = {}; // Not every CPU (or VM) has every counter
+    int counterFd[SweepPerfCounterCount] = {};
+    uint32_t openCounterCount = 0;
+
+    SweepPerfTotals totals[SweepPerfPhaseCount] = {}; // Since the last ResetSweepPerfCounters
+    uint64_t phaseStart[SweepPerfPhaseCount][SweepPerfCounterCount] = {};
+};
+
+static const char* SweepPerfPhaseNames[SweepPerfPhaseCount] = {
+    "Sweep", "Site events", "Circle events", "Point location", "Finalisation"
+};
+
+#ifdef FORTUNE_PERF_COUNTERS
+static int OpenSweepPerfCounter(uint32_t type, uint64_t config, int groupFd)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = (groupFd == -1) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+// NOTE: With PERF_FORMAT_GROUP a single read returns every counter in the group, in the order in
+//       which they were opened.
+static void ReadSweepPerfCounters(const SweepPerfCounters& counters, uint64_t* values)
+{
+    uint64_t buffer[1 + SweepPerfCounterCount] = {};
+    size_t readSize = (1 + counters.openCounterCount)*sizeof(uint64_t);
+    if(read(counters.counterFd[(uint32_t)SweepPerfCounter::Cycles], buffer, readSize) != (ssize_t)readSize)
+    {
+        memset(buffer, 0, sizeof(buffer));
+    }
+    uint32_t next = 1;
+    for(uint32_t i=0; i<SweepPerfCounterCount; i++)
+    {
+        values[i] = counters.isCounterOpen[i] ? buffer[next++] : 0;
+    }
+}
+#endif // FORTUNE_PERF_COUNTERS
+
+// NOTE: Returns false if the counters are not available, which is always the case on platforms
+//       other than Linux and is also the case on Linux when perf_event_paranoid does not allow them.
+//       The cycle counter leads the group, so without it nothing is counted. Without any of the
+//       others, that counter is just left out of the report.
+bool OpenSweepPerfCounters(SweepPerfCounters& counters)
+{
+    counters.isOpen = false;
+#ifdef FORTUNE_PERF_COUNTERS
+    const uint64_t cacheReadMiss = ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) | ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint32_t types[SweepPerfCounterCount] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+    };
+    const uint64_t configs[SweepPerfCounterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | cacheReadMiss,
+        PERF_COUNT_HW_CACHE_LL | cacheReadMiss,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    int groupFd = -1;
+    counters.openCounterCount = 0;
+    for(uint32_t i=0; i<SweepPerfCounterCount; i++)
+    {
+        counters.counterFd[i] = OpenSweepPerfCounter(types[i], configs[i], groupFd);
+        counters.isCounterOpen[i] = (counters.counterFd[i] >= 0);
+        if(i == (uint32_t)SweepPerfCounter::Cycles)
+        {
+            if(!counters.isCounterOpen[i])
+            {
+                return false;
+            }
+            groupFd = counters.counterFd[i];
+        }
+        if(counters.isCounterOpen[i])
+        {
+            counters.openCounterCount++;
+        }
+    }
+    ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    counters.isOpen = true;
+#endif // FORTUNE_PERF_COUNTERS
+    return counters.isOpen;
+}
+
+void CloseSweepPerfCounters(SweepPerfCounters& counters)
+{
+#ifdef FORTUNE_PERF_COUNTERS
+    if(counters.isOpen)
+    {
+        for(uint32_t i=0; i<SweepPerfCounterCount; i++)
+        {
+            if(counters.isCounterOpen[i])
+            {
+                close(counters.counterFd[i]);
+                counters.isCounterOpen[i] = false;
+            }
+        }
+    }
+#endif // FORTUNE_PERF_COUNTERS
+    counters.isOpen = false;
+}
+
+// NOTE: RunFortuneSweep resets the counters before anything else, so that the totals are always for
+//       the latest run (even one that finishes early, or is cancelled part of the way through).
+void ResetSweepPerfCounters(SweepPerfCounters& counters)
+{
+    memset(counters.totals, 0, sizeof(counters.totals));
+}
+
+// NOTE: These take a pointer so that the sweep can call them unconditionally, and they do nothing
+//       if it is null (or the counters could not be opened).
+static inline void BeginSweepPerfPhase(SweepPerfCounters* counters, SweepPerfPhase phase)
+{
+#ifdef FORTUNE_PERF_COUNTERS
+    if((counters != nullptr) && counters->isOpen)
+    {
+        ReadSweepPerfCounters(*counters, counters->phaseStart[(uint32_t)phase]);
+    }
+#else
+    (void)counters;
+    (void)phase;
+#endif // FORTUNE_PERF_COUNTERS
+}
+
+static inline void EndSweepPerfPhase(SweepPerfCounters* counters, SweepPerfPhase phase)
+{
+#ifdef FORTUNE_PERF_COUNTERS
+    if((counters != nullptr) && counters->isOpen)
+    {
+        uint64_t values[SweepPerfCounterCount];
+        ReadSweepPerfCounters(*counters, values);
+        SweepPerfTotals& totals = counters->totals[(uint32_t)phase];
+        for(uint32_t i=0; i<SweepPerfCounterCount; i++)
+        {
+            totals.count[i] += values[i] - counters->phaseStart[(uint32_t)phase][i];
+        }
+        totals.phaseCount++;
+    }
+#else
+    (void)counters;
+    (void)phase;
+#endif // FORTUNE_PERF_COUNTERS
+}
+
+// NOTE: Writes one line per phase with the totals for the last run and the averages per event
+void PrintSweepPerfCounters(const SweepPerfCounters& counters, FILE* output)
+{
+    if(!counters.isOpen)
+    {
+        fprintf(output, "Performance counters are not available\n");
+        return;
+    }
+
+    fprintf(output, "%-15s %10s %14s %14s %6s %12s %12s %12s\n",
+            "Phase", "Count", "Cycles", "Instructions", "IPC", "L1D misses", "LLC misses", "Br. misses");
+    for(uint32_t phase=0; phase<SweepPerfPhaseCount; phase++)
+    {
+        const SweepPerfTotals& totals = counters.totals[phase];
+        double cycles = (double)totals.count[(uint32_t)SweepPerfCounter::Cycles];
+        double instructions = (double)totals.count[(uint32_t)SweepPerfCounter::Instructions];
+        double instructionsPerCycle = (cycles > 0.0) ? (instructions/cycles) : 0.0;
+        fprintf(output, "%-15s %10llu %14llu %14llu %6.2f", SweepPerfPhaseNames[phase],
+                (unsigned long long)totals.phaseCount, (unsigned long long)totals.count[(uint32_t)SweepPerfCounter::Cycles],
+                (unsigned long long)totals.count[(uint32_t)SweepPerfCounter::Instructions], instructionsPerCycle);
+        for(uint32_t i=(uint32_t)SweepPerfCounter::L1DataMisses; i<SweepPerfCounterCount; i++)
+        {
+            if(counters.isCounterOpen[i])
+            {
+                fprintf(output, " %12llu", (unsigned long long)totals.count[i]);
+            }
+            else
+            {
+                fprintf(output, " %12s", "n/a");
+            }
+        }
+        fprintf(output, "\n");
+    }
+
+    fprintf(output, "%-15s %10s %14s %14s %6s %12s %12s %12s\n",
+            "Per event", "", "Cycles", "Instructions", "", "L1D misses", "LLC misses", "Br. misses");
+    for(uint32_t phase=(uint32_t)SweepPerfPhase::SiteEvents; phase<=(uint32_t)SweepPerfPhase::PointLocation; phase++)
+    {
+        const SweepPerfTotals& totals = counters.totals[phase];
+        double eventCount = (totals.phaseCount > 0) ? (double)totals.phaseCount : 1.0;
+        fprintf(output, "%-15s %10s", SweepPerfPhaseNames[phase], "");
+        for(uint32_t i=0; i<SweepPerfCounterCount; i++)
+        {
+            if(i == (uint32_t)SweepPerfCounter::L1DataMisses)
+            {
+                fprintf(output, " %6s", "");
+            }
+            int width = (i < (uint32_t)SweepPerfCounter::L1DataMisses) ? 14 : 12;
+            if(counters.isCounterOpen[i])
+            {
+                fprintf(output, " %*.2f", width, (double)totals.count[i]/eventCount);
+            }
+            else
+            {
+                fprintf(output, " %*s", width, "n/a");
+            }
+        }
+        fprintf(output, "\n");
+    }
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: Computes the Voronoi diagram on a torus, i.e. in the domain [0, size.x) by [0, size.y)
+//       with opposite sides of the domain glued together. Rather than sweeping nine copies of every
+//       site, we only add "ghost" copies of the sites within a margin of the domain's boundary, which
+//       is enough for every cell of a site in the domain to come out exactly as it would on the torus.
+//
+//       The output is an ordinary FortuneState over the (wrapped, deduplicated) input sites, so
+//       BuildSiteAdjacency gives the toroidal adjacency and cells wrap across the boundary.
+//       Every edge of the torus is output exactly once, with its vertices at the positions that
+//       make it a straight segment, so an edge that crosses the boundary pokes out of the domain and
+//       the copy of a vertex at the far end of it is stored separately from the one in the domain.
+//       Since an edge can separate a site from a copy of another site that is a whole domain away,
+//       only the edge's vertices (and not GetEdgeDirection) should be used to find where it goes.
+struct PeriodicFortuneContext
+{
+    FortuneContext context; // Computes the diagram of the wrapped sites together with their ghosts
+    FortuneState state;
+
+    std::vector<Vector2> extendedSites; // The wrapped sites, followed by the ghosts
+    std::vector<uint32_t> extendedSource; // The input site that each extended site is a copy of
+    std::vector<uint32_t> siteSource; // The site in state.sites that each site of context.state is a copy of
+    std::vector<uint32_t> vertexRemap; // Where each vertex of context.state ended up in state.vertices
+};
+
+static float WrapPeriodicCoordinate(float value, float size)
+{
+    float result = fmodf(value, size);
+    if(result < 0.0f)
+    {
+        result += size;
+    }
+    if(result >= size)
+    {
+        result = 0.0f;
+    }
+    return result;
+}
+
+static void AddPeriodicGhosts(PeriodicFortuneContext& context, uint32_t inputSiteCount, Vector2 domainSize, float margin)
+{
+    context.extendedSites.resize(inputSiteCount);
+    context.extendedSource.resize(inputSiteCount);
+    for(uint32_t site=0; site<inputSiteCount; site++)
+    {
+        context.extendedSource[site] = site;
+    }
+    // NOTE: The margin is usually much smaller than the domain, but with only a handful of sites
+    //       it can take more than one copy of the domain on each side to surround every cell.
+    int offsetRangeX = (int)ceilf(margin/domainSize.x);
+    int offsetRangeY = (int)ceilf(margin/domainSize.y);
+    for(uint32_t site=0; site<inputSiteCount; site++)
+    {
+        Vector2 position = context.extendedSites[site];
+        for(int offsetY=-offsetRangeY; offsetY<=offsetRangeY; offsetY++)
+        {
+            for(int offsetX=-offsetRangeX; offsetX<=offsetRangeX; offsetX++)
+            {
+                if((offsetX == 0) && (offsetY == 0)) continue;
+                Vector2 ghost = {position.x + (float)offsetX*domainSize.x, position.y + (float)offsetY*domainSize.y};
+                if((ghost.x >= -margin) && (ghost.x <= domainSize.x + margin) &&
+                   (ghost.y >= -margin) && (ghost.y <= domainSize.y + margin))
+                {
+                    context.extendedSites.push_back(ghost);
+                    context.extendedSource.push_back(site);
+                }
+            }
+        }
+    }
+}
+
+// NOTE: Each edge of the torus shows up in the extended diagram once for every copy of it, and
+//       we want exactly one of them. We keep the copy where the site with the lower index is the
+//       one in the domain. For an edge between a site and one of its own copies, both of the edge's
+//       copies have the site in the domain, so we keep the one where the other copy is the one
+//       offset in the positive direction.
+static bool IsCanonicalPeriodicEdge(const PeriodicFortuneContext& context, uint32_t siteA, uint32_t siteB, Vector2 domainSize)
+{
+    uint32_t sourceA = context.siteSource[siteA];
+    uint32_t sourceB = context.siteSource[siteB];
+    bool isAInDomain = (siteA < context.state.sites.size());
+    bool isBInDomain = (siteB < context.state.sites.size());
+    if(!isAInDomain && !isBInDomain)
+    {
+        return false;
+    }
+    if(sourceA != sourceB)
+    {
+        return (sourceA < sourceB) ? isAInDomain : isBInDomain;
+    }
+
+    uint32_t ghost = isAInDomain ? siteB : siteA;
+    Vector2 ghostPosition = context.context.state.sites[ghost];
+    Vector2 sourcePosition = context.state.sites[sourceA];
+    float offsetX = roundf((ghostPosition.x - sourcePosition.x)/domainSize.x);
+    float offsetY = roundf((ghostPosition.y - sourcePosition.y)/domainSize.y);
+    return (offsetY > 0.0f) || ((offsetY == 0.0f) && (offsetX > 0.0f));
+}
+
+static uint32_t GetPeriodicVertex(PeriodicFortuneContext& context, uint32_t extendedVertex)
+{
+    if(extendedVertex == InvalidIndex)
+    {
+        return InvalidIndex;
+    }
+    if(context.vertexRemap[extendedVertex] == InvalidIndex)
+    {
+        context.vertexRemap[extendedVertex] = (uint32_t)context.state.vertices.size();
+        context.state.vertices.push_back(context.context.state.vertices[extendedVertex]);
+    }
+    return context.vertexRemap[extendedVertex];
+}
+
+// NOTE: The cell of a site in the domain is exact if every site that could be closer to some point
+//       of the cell than the cell's own site is included. At each vertex of the cell, those sites
+//       are all within the distance from the vertex to the cell's site, and everything within
+//       `margin` of the domain is included, so it is enough to check that the circle around each
+//       vertex stays within the margin. Cells are convex, so checking their vertices is enough.
+//       Returns how large the margin would need to be for all of the cells to pass that check.
+static float GetRequiredPeriodicMargin(const FortuneState& extended, uint32_t wrappedSiteCount, Vector2 domainSize)
+{
+    float requiredMargin = 0.0f;
+    for(const CompleteEdge& edge : extended.edges)
+    {
+        uint32_t site = (edge.leftSite < wrappedSiteCount) ? edge.leftSite : edge.rightSite;
+        if(site >= wrappedSiteCount)
+        {
+            continue;
+        }
+        if((edge.vertexA == InvalidIndex) || (edge.vertexB == InvalidIndex))
+        {
+            return FLT_MAX;
+        }
+
+        uint32_t vertices[] = {edge.vertexA, edge.vertexB};
+        for(uint32_t vertex : vertices)
+        {
+            Vector2 position = extended.vertices[vertex];
+            Vector2 offset = {position.x - extended.sites[site].x, position.y - extended.sites[site].y};
+            float radius = sqrtf(offset.x*offset.x + offset.y*offset.y);
+            requiredMargin = max(requiredMargin, radius - position.x);
+            requiredMargin = max(requiredMargin, radius - position.y);
+            requiredMargin = max(requiredMargin, position.x + radius - domainSize.x);
+            requiredMargin = max(requiredMargin, position.y + radius - domainSize.y);
+        }
+    }
+    return requiredMargin;
+}
+
+// NOTE: Sites are first wrapped into the domain. The returned state's canonicalSite maps each input
+//       site to its cell, just as it does for FortunesAlgorithm. The margin starts at twice the
+//       average spacing between sites and grows until the check above passes. Adding sites only
+//       shrinks the cells, so growing the margin to what the check asked for almost always passes
+//       on the next attempt (it only fails again while some cell is still unbounded).
+const FortuneState& FortunesAlgorithmPeriodic(PeriodicFortuneContext& context, const std::vector<Vector2>& sites,
+                                              Vector2 domainSize)
+{
+    TRACE_SCOPE("Periodic diagram");
+    FortuneState& state = context.state;
+    state.sites.clear();
+    state.canonicalSite.clear();
+    state.vertices.clear();
+    state.edges.clear();
+    state.unencounteredEvents.clear();
+    ClearBeachline(state.beachline);
+    state.sweepY = 0.0f;
+    if(sites.empty())
+    {
+        return state;
+    }
+
+    uint32_t inputSiteCount = (uint32_t)sites.size();
+    context.extendedSites.resize(inputSiteCount);
+    for(uint32_t i=0; i<inputSiteCount; i++)
+    {
+        context.extendedSites[i] = {WrapPeriodicCoordinate(sites[i].x, domainSize.x),
+                                    WrapPeriodicCoordinate(sites[i].y, domainSize.y)};
+    }
+
+    float margin = 2.0f*sqrtf(domainSize.x*domainSize.y/(float)inputSiteCount);
+    while(true)
+    {
+        AddPeriodicGhosts(context, inputSiteCount, domainSize, margin);
+        FortunesAlgorithm(context.context, context.extendedSites, -FLT_MAX);
+
+        // NOTE: Duplicates are merged into the first of them and the wrapped sites come before all of
+        //       the ghosts, so the cells of the wrapped sites come first too.
+        const std::vector<uint32_t>& canonicalSite = context.context.state.canonicalSite;
+        uint32_t wrappedSiteCount = 0;
+        for(uint32_t i=0; i<inputSiteCount; i++)
+        {
+            wrappedSiteCount = std::max(wrappedSiteCount, canonicalSite[i] + 1);
+        }
+
+        float requiredMargin = GetRequiredPeriodicMargin(context.context.state, wrappedSiteCount, domainSize);
+        if(requiredMargin <= margin)
+        {
+            state.sites.assign(context.context.state.sites.begin(), context.context.state.sites.begin() + wrappedSiteCount);
+            state.canonicalSite.assign(canonicalSite.begin(), canonicalSite.begin() + inputSiteCount);
+            break;
+        }
+        margin = (requiredMargin == FLT_MAX) ? 2.0f*margin : 1.001f*requiredMargin;
+    }
+
+    const FortuneState& extended = context.context.state;
+    context.siteSource.assign(extended.sites.size(), InvalidIndex);
+    for(size_t i=0; i<context.extendedSites.size(); i++)
+    {
+        uint32_t site = extended.canonicalSite[i];
+        if(context.siteSource[site] == InvalidIndex)
+        {
+            context.siteSource[site] = state.canonicalSite[context.extendedSource[i]];
+        }
+    }
+
+    context.vertexRemap.assign(extended.vertices.size(), InvalidIndex);
+    for(const CompleteEdge& edge : extended.edges)
+    {
+        if(!IsCanonicalPeriodicEdge(context, edge.leftSite, edge.rightSite, domainSize))
+        {
+            continue;
+        }
+        CompleteEdge periodicEdge;
+        periodicEdge.vertexA = GetPeriodicVertex(context, edge.vertexA);
+        periodicEdge.vertexB = GetPeriodicVertex(context, edge.vertexB);
+        periodicEdge.leftSite = context.siteSource[edge.leftSite];
+        periodicEdge.rightSite = context.siteSource[edge.rightSite];
+        state.edges.push_back(periodicEdge);
+    }
+    return state;
+}
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <float.h>
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+#ifndef PLATFORM_WEB
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif // PLATFORM_WEB
+
+// NOTE: One diagram to be computed by RunFortunePipeline.
+//       ingest fills in the (already cleared) site list, and runs on the preparation thread.
+//       finalise receives the finished diagram, and runs on one of the finalisation threads. The
+//       state it receives is only valid for the duration of the call.
+struct FortuneJob
+{
+    std::function<void(std::vector<Vector2>&)> ingest;
+    std::function<void(const FortuneState&)> finalise;
+    float cutoffY = -FLT_MAX;
+};
+
+// NOTE: Everything needed to carry one job through the pipeline. Slots are recycled once their
+//       job has been finalised, so after the first few jobs the pipeline stops allocating.
+struct FortunePipelineSlot
+{
+    std::vector<Vector2> sites;
+    FortuneContext context;
+    size_t job;
+};
+
+#ifndef PLATFORM_WEB
+struct FortuneSlotQueue
+{
+    std::mutex lock;
+    std::condition_variable available;
+    std::vector<uint32_t> slots;
+    bool isClosed = false;
+};
+
+static void PushSlot(FortuneSlotQueue& queue, uint32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.slots.push_back(slot);
+    }
+    queue.available.notify_one();
+}
+
+static void CloseSlotQueue(FortuneSlotQueue& queue)
+{
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.isClosed = true;
+    }
+    queue.available.notify_all();
+}
+
+// NOTE: Blocks until a slot is available, and returns false once the queue has been closed and emptied.
+//       Slots come out in the order they went in, so the sweep sees jobs in submission order.
+static bool PopSlot(FortuneSlotQueue& queue, uint32_t& slot)
+{
+    std::unique_lock<std::mutex> guard(queue.lock);
+    while(queue.slots.empty() && !queue.isClosed)
+    {
+        queue.available.wait(guard);
+    }
+    if(queue.slots.empty())
+    {
+        return false;
+    }
+    slot = queue.slots.front();
+    queue.slots.erase(queue.slots.begin());
+    return true;
+}
+#endif // PLATFORM_WEB
+
+// NOTE: Computes a batch of diagrams with the stages of successive jobs overlapped:
+//       A preparation thread ingests and sorts the sites for upcoming jobs, the calling thread runs
+//       the sweeps one after another, and finaliseThreadCount threads consume the finished diagrams.
+//       As long as ingest and finalise keep up, the batch takes as long as its sweeps do.
+//       Jobs are swept in order, but with more than one finalisation thread they can be finalised
+//       out of order.
+void RunFortunePipeline(const std::vector<FortuneJob>& jobs, int finaliseThreadCount)
+{
+#ifdef PLATFORM_WEB
+    // NOTE: The web build is compiled without pthread support, so just run each job start to finish
+    (void)finaliseThreadCount;
+    FortunePipelineSlot slot;
+    for(size_t i=0; i<jobs.size(); i++)
+    {
+        slot.sites.clear();
+        jobs[i].ingest(slot.sites);
+        const FortuneState& state = FortunesAlgorithm(slot.context, slot.sites, jobs[i].cutoffY);
+        jobs[i].finalise(state);
+    }
+#else
+    if(finaliseThreadCount < 1) finaliseThreadCount = 1;
+
+    // NOTE: One slot for each finalisation thread, one being swept, one being prepared and
+    //       one ready and waiting, so that no stage needs to wait for a slot while the others are busy.
+    uint32_t slotCount = (uint32_t)finaliseThreadCount + 3;
+    std::vector<FortunePipelineSlot> slots(slotCount);
+    FortuneSlotQueue freeQueue;
+    FortuneSlotQueue sweepQueue;
+    FortuneSlotQueue finaliseQueue;
+    freeQueue.slots.reserve(slotCount);
+    sweepQueue.slots.reserve(slotCount);
+    finaliseQueue.slots.reserve(slotCount);
+    for(uint32_t i=0; i<slotCount; i++)
+    {
+        freeQueue.slots.push_back(i);
+    }
+
+    std::thread prepareThread([&]()
+    {
+        for(size_t job=0; job<jobs.size(); job++)
+        {
+            uint32_t slotIndex;
+            bool gotSlot = PopSlot(freeQueue, slotIndex);
+            assert(gotSlot);
+            (void)gotSlot;
+
+            FortunePipelineSlot& slot = slots[slotIndex];
+            slot.job = job;
+            slot.sites.clear();
+            jobs[job].ingest(slot.sites);
+            PrepareFortuneSites(slot.context, slot.sites);
+            PushSlot(sweepQueue, slotIndex);
+        }
+        CloseSlotQueue(sweepQueue);
+    });
+
+    std::vector<std::thread> finaliseThreads;
+    finaliseThreads.reserve(finaliseThreadCount);
+    for(int i=0; i<finaliseThreadCount; i++)
+    {
+        finaliseThreads.emplace_back([&]()
+        {
+            uint32_t slotIndex;
+            while(PopSlot(finaliseQueue, slotIndex))
+            {
+                FortunePipelineSlot& slot = slots[slotIndex];
+                jobs[slot.job].finalise(slot.context.state);
+                PushSlot(freeQueue, slotIndex);
+            }
+        });
+    }
+
+    uint32_t slotIndex;
+    while(PopSlot(sweepQueue, slotIndex))
+    {
+        FortunePipelineSlot& slot = slots[slotIndex];
+        RunFortuneSweep(slot.context, jobs[slot.job].cutoffY);
+        PushSlot(finaliseQueue, slotIndex);
+    }
+    CloseSlotQueue(finaliseQueue);
+
+    prepareThread.join();
+    for(std::thread& thread : finaliseThreads)
+    {
+        thread.join();
+    }
+#endif // PLATFORM_WEB
+}
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// NOTE: Builds the Gabriel graph, relative neighbourhood graph and Euclidean minimum spanning tree
+//       of a finished diagram's sites. Each of these is a subgraph of the one before it, and the
+//       Gabriel graph is a subgraph of the Delaunay graph, so each is built by filtering the edges of
+//       the one before it and none of them need anything beyond the diagram and its SiteAdjacency.
+//       Each graph is a list of site pairs with the lower index first, sorted by that pair (except
+//       for the spanning tree, which is sorted by length). Every site is connected in all of them.
+struct ProximityEdge
+{
+    uint32_t siteA;
+    uint32_t siteB;
+};
+
+struct ProximityGraphs
+{
+    std::vector<ProximityEdge> gabriel;
+    std::vector<ProximityEdge> relativeNeighbourhood;
+    std::vector<ProximityEdge> spanningTree;
+
+    // Scratch space, kept between calls so that rebuilding the graphs does not need to allocate
+    std::vector<uint64_t> sortKeys;
+    std::vector<uint32_t> componentParent;
+    std::vector<uint32_t> floodSites;
+    std::vector<uint32_t> visitedStamp; // visitedStamp[i] == stamp iff site i has been reached in this lune test
+    uint32_t stamp = 0;
+};
+
+static float GetProximityDistanceSq(Vector2 from, Vector2 to)
+{
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    return dx*dx + dy*dy;
+}
+
+// NOTE: Two sites are Gabriel neighbours iff no other site is inside or on the circle that has them
+//       on opposite ends of its diameter. The centre of that circle is closer to the two of them than
+//       to any other site exactly when it is strictly inside the Voronoi edge between them, so we
+//       only need to check whether their midpoint falls strictly between the edge's two ends.
+static bool IsGabrielEdge(const FortuneState& state, const CompleteEdge& edge)
+{
+    Vector2 left = state.sites[edge.leftSite];
+    Vector2 right = state.sites[edge.rightSite];
+    Vector2 midpoint = {0.5f*(left.x + right.x), 0.5f*(left.y + right.y)};
+    Vector2 direction = GetEdgeDirection(state, edge);
+    if(edge.vertexA != InvalidIndex)
+    {
+        Vector2 start = state.vertices[edge.vertexA];
+        if((midpoint.x - start.x)*direction.x + (midpoint.y - start.y)*direction.y <= 0.0f)
+        {
+            return false;
+        }
+    }
+    if(edge.vertexB != InvalidIndex)
+    {
+        Vector2 end = state.vertices[edge.vertexB];
+        if((midpoint.x - end.x)*direction.x + (midpoint.y - end.y)*direction.y >= 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NOTE: Returns true if some other site is closer to both ends of the pair than they are to each
+//       other. Any such site is closer to siteA than siteB is, and each site in a disk around siteA
+//       is a Delaunay neighbour of a site in the disk that is closer to siteA (the same fact that
+//       ExpandSitesByDistance relies on), so a flood fill from siteA through the sites in that disk
+//       reaches all of them. The blocking site is usually a neighbour of siteA, and those are checked first.
+static bool IsLuneBlocked(const FortuneState& state, const SiteAdjacency& adjacency, ProximityGraphs& graphs,
+                          uint32_t siteA, uint32_t siteB)
+{
+    Vector2 positionA = state.sites[siteA];
+    Vector2 positionB = state.sites[siteB];
+    float pairDistSq = GetProximityDistanceSq(positionA, positionB);
+
+    graphs.stamp++;
+    if(graphs.stamp == 0)
+    {
+        std::fill(graphs.visitedStamp.begin(), graphs.visitedStamp.end(), 0);
+        graphs.stamp = 1;
+    }
+    graphs.visitedStamp[siteA] = graphs.stamp;
+    graphs.visitedStamp[siteB] = graphs.stamp;
+    graphs.floodSites.clear();
+    graphs.floodSites.push_back(siteA);
+    while(!graphs.floodSites.empty())
+    {
+        uint32_t site = graphs.floodSites.back();
+        graphs.floodSites.pop_back();
+        for(uint32_t i=adjacency.firstNeighbour[site]; i<adjacency.firstNeighbour[site+1]; i++)
+        {
+            uint32_t neighbour = adjacency.neighbours[i];
+            if(graphs.visitedStamp[neighbour] == graphs.stamp)
+            {
+                continue;
+            }
+            graphs.visitedStamp[neighbour] = graphs.stamp;
+
+            Vector2 position = state.sites[neighbour];
+            if(GetProximityDistanceSq(positionA, position) < pairDistSq)
+            {
+                if(GetProximityDistanceSq(positionB, position) < pairDistSq)
+                {
+                    return true;
+                }
+                graphs.floodSites.push_back(neighbour);
+            }
+        }
+    }
+    return false;
+}
+
+static uint32_t FindProximityComponent(std::vector<uint32_t>& parent, uint32_t site)
+{
+    while(parent[site] != site)
+    {
+        parent[site] = parent[parent[site]];
+        site = parent[site];
+    }
+    return site;
+}
+
+// NOTE: Only valid for a finished diagram. The Gabriel test is constant time per Voronoi edge and
+//       the spanning tree is Kruskal's algorithm over the relative neighbourhood graph, so apart
+//       from the two sorts the only cost that is not linear in the number of edges is the lune
+//       test, which looks at the sites near one end of each Gabriel edge and the neighbours of
+//       those sites. That is a handful of sites for well-spread input, but can add up for sites
+//       with a very large number of neighbours (e.g. the centre of a ring of sites).
+void BuildProximityGraphs(const FortuneState& state, const SiteAdjacency& adjacency, ProximityGraphs& graphs)
+{
+    TRACE_SCOPE("Proximity graphs");
+    assert(state.beachline.root == InvalidIndex);
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    graphs.gabriel.clear();
+    graphs.relativeNeighbourhood.clear();
+    graphs.spanningTree.clear();
+
+    // NOTE: With degenerate input the sweep can split the edge between two sites in two, so the
+    //       pairs are sorted and duplicates removed (as in BuildSiteAdjacency).
+    graphs.sortKeys.clear();
+    for(const CompleteEdge& edge : state.edges)
+    {
+        if(IsGabrielEdge(state, edge))
+        {
+            uint32_t siteA = std::min(edge.leftSite, edge.rightSite);
+            uint32_t siteB = std::max(edge.leftSite, edge.rightSite);
+            graphs.sortKeys.push_back(((uint64_t)siteA << 32) | siteB);
+        }
+    }
+    std::sort(graphs.sortKeys.begin(), graphs.sortKeys.end());
+    graphs.sortKeys.erase(std::unique(graphs.sortKeys.begin(), graphs.sortKeys.end()), graphs.sortKeys.end());
+    graphs.gabriel.resize(graphs.sortKeys.size());
+    for(size_t i=0; i<graphs.sortKeys.size(); i++)
+    {
+        graphs.gabriel[i] = {(uint32_t)(graphs.sortKeys[i] >> 32), (uint32_t)graphs.sortKeys[i]};
+    }
+
+    graphs.visitedStamp.assign(siteCount, 0);
+    graphs.stamp = 0;
+    for(ProximityEdge edge : graphs.gabriel)
+    {
+        if(!IsLuneBlocked(state, adjacency, graphs, edge.siteA, edge.siteB))
+        {
+            graphs.relativeNeighbourhood.push_back(edge);
+        }
+    }
+
+    // NOTE: Squared lengths are never negative, and the bits of non-negative floats sort in the
+    //       same order as their values, so each key holds the edge's length in its high half and
+    //       its index in its low half.
+    uint32_t relativeNeighbourhoodCount = (uint32_t)graphs.relativeNeighbourhood.size();
+    graphs.sortKeys.resize(relativeNeighbourhoodCount);
+    for(uint32_t i=0; i<relativeNeighbourhoodCount; i++)
+    {
+        ProximityEdge edge = graphs.relativeNeighbourhood[i];
+        float lengthSq = GetProximityDistanceSq(state.sites[edge.siteA], state.sites[edge.siteB]);
+        uint32_t lengthBits;
+        memcpy(&lengthBits, &lengthSq, sizeof(lengthBits));
+        graphs.sortKeys[i] = ((uint64_t)lengthBits << 32) | i;
+    }
+    std::sort(graphs.sortKeys.begin(), graphs.sortKeys.end());
+
+    graphs.componentParent.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        graphs.componentParent[i] = i;
+    }
+    for(uint64_t key : graphs.sortKeys)
+    {
+        ProximityEdge edge = graphs.relativeNeighbourhood[(uint32_t)key];
+        uint32_t componentA = FindProximityComponent(graphs.componentParent, edge.siteA);
+        uint32_t componentB = FindProximityComponent(graphs.componentParent, edge.siteB);
+        if(componentA != componentB)
+        {
+            graphs.componentParent[componentB] = componentA;
+            graphs.spanningTree.push_back(edge);
+            if(graphs.spanningTree.size() + 1 == siteCount)
+            {
+                break;
+            }
+        }
+    }
+    assert((siteCount == 0) || (graphs.spanningTree.size() + 1 == siteCount));
+}
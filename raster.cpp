@@ -0,0 +1,222 @@
+#include <assert.h>
+#include <float.h>
+#include <functional>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#ifndef PLATFORM_WEB
+#include <thread>
+#endif // PLATFORM_WEB
+
+// NOTE: Label images are stored row-major with row 0 at the top (maxCorner.y) of the rasterised
+//       area, to match the screen-space convention used for drawing. Pixel (col,row) is sampled at
+//       its centre, and receives the index of the cell containing that point (or -1 if no cell does).
+struct RasterTarget
+{
+    Vector2 minCorner;
+    Vector2 maxCorner;
+    int32_t* labels;
+    int width;
+    int height;
+};
+
+static Vector2 GetPixelCentre(const RasterTarget& target, int col, int row)
+{
+    float pixelWidth = (target.maxCorner.x - target.minCorner.x)/(float)target.width;
+    float pixelHeight = (target.maxCorner.y - target.minCorner.y)/(float)target.height;
+    Vector2 result = {target.minCorner.x + ((float)col + 0.5f)*pixelWidth,
+                      target.maxCorner.y - ((float)row + 0.5f)*pixelHeight};
+    return result;
+}
+
+static void RasteriseCellRows(const VoronoiCells& cells, const std::vector<Vector2>& cellYRange, const RasterTarget& target, int firstRow, int endRow)
+{
+    float pixelWidth = (target.maxCorner.x - target.minCorner.x)/(float)target.width;
+    float pixelHeight = (target.maxCorner.y - target.minCorner.y)/(float)target.height;
+    for(int row=firstRow; row<endRow; row++)
+    {
+        int32_t* rowLabels = target.labels + (size_t)row*target.width;
+        for(int col=0; col<target.width; col++)
+        {
+            rowLabels[col] = -1;
+        }
+    }
+
+    float bandMaxY = target.maxCorner.y - ((float)firstRow + 0.5f)*pixelHeight;
+    float bandMinY = target.maxCorner.y - ((float)endRow - 0.5f)*pixelHeight;
+    size_t cellCount = cellYRange.size();
+    for(size_t cell=0; cell<cellCount; cell++)
+    {
+        Vector2 yRange = cellYRange[cell];
+        if((yRange.y < bandMinY) || (yRange.x > bandMaxY))
+        {
+            continue;
+        }
+
+        uint32_t begin = cells.firstVertex[cell];
+        uint32_t end = cells.firstVertex[cell+1];
+        uint32_t vertexCount = end - begin;
+        const Vector2* polygon = cells.vertices.data() + begin;
+
+        // Only visit the rows whose pixel centres lie within the cell's vertical extent
+        int cellFirstRow = (int)ceilf((target.maxCorner.y - yRange.y)/pixelHeight - 0.5f);
+        int cellEndRow = (int)floorf((target.maxCorner.y - yRange.x)/pixelHeight - 0.5f) + 1;
+        if(cellFirstRow < firstRow) cellFirstRow = firstRow;
+        if(cellEndRow > endRow) cellEndRow = endRow;
+        for(int row=cellFirstRow; row<cellEndRow; row++)
+        {
+            float y = target.maxCorner.y - ((float)row + 0.5f)*pixelHeight;
+
+            // The cell is convex, so the row crosses its boundary at most twice
+            float spanMinX = FLT_MAX;
+            float spanMaxX = -FLT_MAX;
+            for(uint32_t i=0; i<vertexCount; i++)
+            {
+                Vector2 a = polygon[i];
+                Vector2 b = polygon[(i+1 == vertexCount) ? 0 : i+1];
+                if((a.y <= y) == (b.y <= y))
+                {
+                    continue;
+                }
+                float t = (y - a.y)/(b.y - a.y);
+                float x = a.x + t*(b.x - a.x);
+                spanMinX = min(spanMinX, x);
+                spanMaxX = max(spanMaxX, x);
+            }
+            if(spanMinX > spanMaxX)
+            {
+                continue;
+            }
+
+            int colBegin = (int)ceilf((spanMinX - target.minCorner.x)/pixelWidth - 0.5f);
+            int colEnd = (int)ceilf((spanMaxX - target.minCorner.x)/pixelWidth - 0.5f);
+            if(colBegin < 0) colBegin = 0;
+            if(colEnd > target.width) colEnd = target.width;
+            int32_t* rowLabels = target.labels + (size_t)row*target.width;
+            for(int col=colBegin; col<colEnd; col++)
+            {
+                rowLabels[col] = (int32_t)cell;
+            }
+        }
+    }
+
+    // NOTE: Neighbouring cells are clipped independently, so their shared boundaries can differ by
+    //       a rounding error and leave a pixel centre that lies exactly between them unclaimed.
+    //       Any such pixel goes to whichever of its horizontal neighbours' sites is closer.
+    for(int row=firstRow; row<endRow; row++)
+    {
+        int32_t* rowLabels = target.labels + (size_t)row*target.width;
+        for(int col=0; col<target.width; col++)
+        {
+            if(rowLabels[col] != -1)
+            {
+                continue;
+            }
+            Vector2 centre = GetPixelCentre(target, col, row);
+            float bestDistSq = FLT_MAX;
+            int neighbourCols[2] = {col-1, col+1};
+            for(int neighbourCol : neighbourCols)
+            {
+                if((neighbourCol < 0) || (neighbourCol >= target.width)) continue;
+                int32_t label = rowLabels[neighbourCol];
+                if(label < 0) continue;
+                Vector2 site = cells.sites[label];
+                float distSq = (site.x-centre.x)*(site.x-centre.x) + (site.y-centre.y)*(site.y-centre.y);
+                if(distSq < bestDistSq)
+                {
+                    bestDistSq = distSq;
+                    rowLabels[col] = label;
+                }
+            }
+        }
+    }
+}
+
+// NOTE: Scan-converts the clipped cells into a caller-provided width*height label buffer covering
+//       the rectangle from minCorner to maxCorner. Rows are split into contiguous bands, one per
+//       thread, and every thread only writes to its own rows so no synchronisation is required.
+void RasteriseCells(const VoronoiCells& cells, Vector2 minCorner, Vector2 maxCorner,
+                    int32_t* labels, int width, int height, int threadCount)
+{
+    assert((labels != nullptr) && (width > 0) && (height > 0));
+    RasterTarget target = {minCorner, maxCorner, labels, width, height};
+
+    size_t cellCount = cells.firstVertex.empty() ? 0 : cells.firstVertex.size() - 1;
+    std::vector<Vector2> cellYRange(cellCount);
+    for(size_t cell=0; cell<cellCount; cell++)
+    {
+        Vector2 range = {FLT_MAX, -FLT_MAX};
+        for(uint32_t i=cells.firstVertex[cell]; i<cells.firstVertex[cell+1]; i++)
+        {
+            range.x = min(range.x, cells.vertices[i].y);
+            range.y = max(range.y, cells.vertices[i].y);
+        }
+        cellYRange[cell] = range;
+    }
+
+#ifdef PLATFORM_WEB
+    // NOTE: The web build is compiled without pthread support
+    threadCount = 1;
+#endif // PLATFORM_WEB
+    if(threadCount < 1) threadCount = 1;
+    if(threadCount > height) threadCount = height;
+    if(threadCount == 1)
+    {
+        RasteriseCellRows(cells, cellYRange, target, 0, height);
+        return;
+    }
+
+#ifndef PLATFORM_WEB
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    for(int i=0; i<threadCount; i++)
+    {
+        int firstRow = (int)(((int64_t)height*i)/threadCount);
+        int endRow = (int)(((int64_t)height*(i+1))/threadCount);
+        threads.emplace_back(RasteriseCellRows, std::cref(cells), std::cref(cellYRange), target, firstRow, endRow);
+    }
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+#endif // PLATFORM_WEB
+}
+
+// NOTE: Validates a label image against brute-force nearest-site labelling, returning the number
+//       of pixels whose label is not (to within a small tolerance for ties) the nearest site.
+int CountRasterMismatches(const VoronoiCells& cells, Vector2 minCorner, Vector2 maxCorner,
+                          const int32_t* labels, int width, int height)
+{
+    RasterTarget target = {minCorner, maxCorner, nullptr, width, height};
+    float pixelSize = max((maxCorner.x - minCorner.x)/(float)width, (maxCorner.y - minCorner.y)/(float)height);
+    float tolerance = 1e-2f*pixelSize;
+
+    int mismatchCount = 0;
+    for(int row=0; row<height; row++)
+    {
+        for(int col=0; col<width; col++)
+        {
+            Vector2 centre = GetPixelCentre(target, col, row);
+            float nearestDist = FLT_MAX;
+            for(Vector2 site : cells.sites)
+            {
+                Vector2 offset = {site.x - centre.x, site.y - centre.y};
+                nearestDist = min(nearestDist, Magnitude(offset));
+            }
+
+            int32_t label = labels[(size_t)row*width + col];
+            if((label < 0) || ((size_t)label >= cells.sites.size()))
+            {
+                mismatchCount++;
+                continue;
+            }
+            Vector2 labelOffset = {cells.sites[label].x - centre.x, cells.sites[label].y - centre.y};
+            if(Magnitude(labelOffset) > nearestDist + tolerance)
+            {
+                mismatchCount++;
+            }
+        }
+    }
+    return mismatchCount;
+}
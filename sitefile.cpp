@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <float.h>
+#include <functional>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_WIN32)
+// NOTE: These keep windows.h from declaring things that clash with raylib (Rectangle, CloseWindow,
+//       DrawText, PlaySound and so on) or with mathutil (the min and max macros).
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef PLATFORM_WEB
+#include <thread>
+#endif // PLATFORM_WEB
+
+// NOTE: Loads sites from a text file with one site per line, written as its x and y coordinates
+//       separated by a comma, semicolon or whitespace (so CSV files and plain whitespace-separated
+//       columns both work). Blank lines are skipped, and anything else is an error.
+//
+//       The file is memory-mapped rather than read, and split into one chunk per hardware thread
+//       at line boundaries. Each chunk is first scanned for the number of lines and sites in it,
+//       which tells every chunk where its first site goes and what its first line number is, and
+//       then the chunks are all parsed in parallel straight into their part of the output.
+struct SiteFileError
+{
+    size_t line; // The (1-based) line that the error is on, or 0 if the file itself could not be read
+    const char* message;
+};
+
+struct SiteFileChunk
+{
+    const char* begin;
+    const char* end;
+    size_t lineCount;
+    size_t siteCount;
+    size_t firstLine;
+    Vector2* sites; // Where the chunk's first site goes
+    SiteFileError error;
+};
+
+// NOTE: Files smaller than this are not worth splitting up between threads
+static const size_t MinSiteFileChunkSize = 1 << 20;
+
+static bool IsSiteFileSpace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+static bool IsSiteFileDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+// NOTE: Parses a decimal number starting at `cursor` and returns where it ends, or nullptr if
+//       there is no number there (or it does not fit in a float). std::from_chars would do this
+//       but needs C++17, which the web build does not use, and strtof needs a null-terminated
+//       string, which a mapped file is not. When the digits fit in 53 bits and the power of ten
+//       is one that a double holds exactly, the number is correctly rounded to double and then to
+//       float (which only differs from rounding straight to float in vanishingly rare halfway
+//       cases), and everything else goes to strtof on a null-terminated copy.
+static const char* ParseSiteCoordinate(const char* cursor, const char* end, float& value)
+{
+    static const double exactPowersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* start = cursor;
+    bool isNegative = false;
+    if((cursor < end) && ((*cursor == '-') || (*cursor == '+')))
+    {
+        isNegative = (*cursor == '-');
+        cursor++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool isExact = true;
+    for(; (cursor < end) && IsSiteFileDigit(*cursor); cursor++)
+    {
+        hasDigits = true;
+        if(mantissa < (1ull << 53))
+        {
+            mantissa = 10*mantissa + (uint64_t)(*cursor - '0');
+        }
+        else
+        {
+            isExact = false;
+        }
+    }
+    if((cursor < end) && (*cursor == '.'))
+    {
+        cursor++;
+        for(; (cursor < end) && IsSiteFileDigit(*cursor); cursor++)
+        {
+            hasDigits = true;
+            if(mantissa < (1ull << 53))
+            {
+                mantissa = 10*mantissa + (uint64_t)(*cursor - '0');
+                exponent--;
+            }
+            else
+            {
+                isExact = false;
+            }
+        }
+    }
+    if(!hasDigits)
+    {
+        return nullptr;
+    }
+    if((cursor < end) && ((*cursor == 'e') || (*cursor == 'E')))
+    {
+        cursor++;
+        bool isExponentNegative = false;
+        if((cursor < end) && ((*cursor == '-') || (*cursor == '+')))
+        {
+            isExponentNegative = (*cursor == '-');
+            cursor++;
+        }
+        if((cursor == end) || !IsSiteFileDigit(*cursor))
+        {
+            return nullptr;
+        }
+        int explicitExponent = 0;
+        for(; (cursor < end) && IsSiteFileDigit(*cursor); cursor++)
+        {
+            explicitExponent = std::min(10*explicitExponent + (*cursor - '0'), 100000);
+        }
+        exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+    }
+
+    if(isExact && (mantissa <= (1ull << 53)) && (exponent >= -22) && (exponent <= 22))
+    {
+        double result = (double)mantissa;
+        result = (exponent < 0) ? (result/exactPowersOfTen[-exponent]) : (result*exactPowersOfTen[exponent]);
+        value = (float)(isNegative ? -result : result);
+    }
+    else
+    {
+        char buffer[128];
+        size_t length = (size_t)(cursor - start);
+        if(length >= sizeof(buffer))
+        {
+            return nullptr;
+        }
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+        value = strtof(buffer, nullptr);
+    }
+    if(!(fabsf(value) <= FLT_MAX))
+    {
+        return nullptr;
+    }
+    return cursor;
+}
+
+static void CountSiteFileChunk(SiteFileChunk& chunk)
+{
+    chunk.lineCount = 0;
+    chunk.siteCount = 0;
+    const char* cursor = chunk.begin;
+    while(cursor < chunk.end)
+    {
+        const char* lineEnd = (const char*)memchr(cursor, '\n', (size_t)(chunk.end - cursor));
+        if(lineEnd == nullptr)
+        {
+            lineEnd = chunk.end;
+        }
+        while((cursor < lineEnd) && IsSiteFileSpace(*cursor))
+        {
+            cursor++;
+        }
+        if(cursor < lineEnd)
+        {
+            chunk.siteCount++;
+        }
+        chunk.lineCount++;
+        cursor = lineEnd + 1;
+    }
+}
+
+// NOTE: Stops at the first error in the chunk, so later lines in it are left unparsed
+static void ParseSiteFileChunk(SiteFileChunk& chunk)
+{
+    chunk.error = {0, nullptr};
+    Vector2* site = chunk.sites;
+    size_t line = chunk.firstLine;
+    const char* cursor = chunk.begin;
+    for(; cursor < chunk.end; line++)
+    {
+        const char* lineEnd = (const char*)memchr(cursor, '\n', (size_t)(chunk.end - cursor));
+        if(lineEnd == nullptr)
+        {
+            lineEnd = chunk.end;
+        }
+        while((cursor < lineEnd) && IsSiteFileSpace(*cursor))
+        {
+            cursor++;
+        }
+        if(cursor == lineEnd)
+        {
+            cursor = lineEnd + 1;
+            continue;
+        }
+
+        Vector2 position;
+        cursor = ParseSiteCoordinate(cursor, lineEnd, position.x);
+        if(cursor == nullptr)
+        {
+            chunk.error = {line, "Expected an x coordinate"};
+            return;
+        }
+        bool hasSeparator = false;
+        while((cursor < lineEnd) && IsSiteFileSpace(*cursor))
+        {
+            cursor++;
+            hasSeparator = true;
+        }
+        if((cursor < lineEnd) && ((*cursor == ',') || (*cursor == ';')))
+        {
+            cursor++;
+            hasSeparator = true;
+            while((cursor < lineEnd) && IsSiteFileSpace(*cursor))
+            {
+                cursor++;
+            }
+        }
+        if(hasSeparator)
+        {
+            cursor = ParseSiteCoordinate(cursor, lineEnd, position.y);
+        }
+        else
+        {
+            cursor = nullptr;
+        }
+        if(cursor == nullptr)
+        {
+            chunk.error = {line, "Expected a y coordinate"};
+            return;
+        }
+        while((cursor < lineEnd) && IsSiteFileSpace(*cursor))
+        {
+            cursor++;
+        }
+        if(cursor != lineEnd)
+        {
+            chunk.error = {line, "Unexpected text after the y coordinate"};
+            return;
+        }
+        *site++ = position;
+        cursor = lineEnd + 1;
+    }
+}
+
+// NOTE: Runs the work for every chunk, with all but the first chunk on their own threads
+static void ProcessSiteFileChunks(std::vector<SiteFileChunk>& chunks, void (*work)(SiteFileChunk&))
+{
+#ifdef PLATFORM_WEB
+    for(SiteFileChunk& chunk : chunks)
+    {
+        work(chunk);
+    }
+#else
+    std::vector<std::thread> threads;
+    threads.reserve(chunks.size());
+    for(size_t i=1; i<chunks.size(); i++)
+    {
+        threads.emplace_back(work, std::ref(chunks[i]));
+    }
+    work(chunks[0]);
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+#endif // PLATFORM_WEB
+}
+
+static void ParseSiteFile(const char* data, size_t size, std::vector<Vector2>& sites, SiteFileError& error)
+{
+    size_t chunkCount = 1;
+#ifndef PLATFORM_WEB
+    chunkCount = std::max(1u, std::thread::hardware_concurrency());
+    chunkCount = std::max<size_t>(1, std::min(chunkCount, size/MinSiteFileChunkSize));
+#endif // PLATFORM_WEB
+
+    // NOTE: Every chunk but the first starts just after a newline, so that no line is split
+    std::vector<SiteFileChunk> chunks;
+    const char* end = data + size;
+    const char* chunkBegin = data;
+    for(size_t i=0; i<chunkCount; i++)
+    {
+        const char* chunkEnd = end;
+        if(i+1 < chunkCount)
+        {
+            chunkEnd = data + (size*(i+1))/chunkCount;
+            chunkEnd = (chunkEnd < chunkBegin) ? chunkBegin : chunkEnd;
+            const char* newline = (const char*)memchr(chunkEnd, '\n', (size_t)(end - chunkEnd));
+            chunkEnd = (newline != nullptr) ? (newline + 1) : end;
+        }
+        if(chunkEnd > chunkBegin)
+        {
+            SiteFileChunk chunk = {};
+            chunk.begin = chunkBegin;
+            chunk.end = chunkEnd;
+            chunks.push_back(chunk);
+        }
+        chunkBegin = chunkEnd;
+    }
+
+    sites.clear();
+    if(chunks.empty())
+    {
+        return;
+    }
+    ProcessSiteFileChunks(chunks, CountSiteFileChunk);
+    size_t siteCount = 0;
+    for(const SiteFileChunk& chunk : chunks)
+    {
+        siteCount += chunk.siteCount;
+    }
+    sites.resize(siteCount);
+
+    size_t lineCount = 0;
+    Vector2* chunkSites = sites.data();
+    for(SiteFileChunk& chunk : chunks)
+    {
+        chunk.firstLine = lineCount + 1;
+        chunk.sites = chunkSites;
+        lineCount += chunk.lineCount;
+        chunkSites += chunk.siteCount;
+    }
+    ProcessSiteFileChunks(chunks, ParseSiteFileChunk);
+    for(const SiteFileChunk& chunk : chunks)
+    {
+        if(chunk.error.message != nullptr)
+        {
+            error = chunk.error;
+            sites.clear();
+            return;
+        }
+    }
+}
+
+// NOTE: Replaces the contents of `sites` with the sites in the file at `path`. Returns false (with
+//       `sites` empty) if the file could not be read or has an error in it, in which case `error`
+//       says what went wrong and, for errors in the contents, on which line.
+//       To skip copying the sites, load them straight into context.state.sites and then call
+//       PrepareFortuneSitesInPlace(context) instead of PrepareFortuneSites.
+bool LoadSiteFile(const char* path, std::vector<Vector2>& sites, SiteFileError& error)
+{
+    TRACE_SCOPE("Load site file");
+    error = {0, nullptr};
+    sites.clear();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        error = {0, "Could not open the file"};
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        error = {0, "Could not get the size of the file"};
+        return false;
+    }
+    size_t size = (size_t)fileSize.QuadPart;
+    if(size > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const char* data = (mapping != nullptr) ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if(data != nullptr)
+        {
+            ParseSiteFile(data, size, sites, error);
+            UnmapViewOfFile(data);
+        }
+        else
+        {
+            error = {0, "Could not map the file into memory"};
+        }
+        if(mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    int file = open(path, O_RDONLY);
+    if(file < 0)
+    {
+        error = {0, "Could not open the file"};
+        return false;
+    }
+    struct stat fileStatus;
+    if(fstat(file, &fileStatus) != 0)
+    {
+        close(file);
+        error = {0, "Could not get the size of the file"};
+        return false;
+    }
+    size_t size = (size_t)fileStatus.st_size;
+    if(size > 0)
+    {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(data != MAP_FAILED)
+        {
+#ifndef PLATFORM_WEB
+            madvise(data, size, MADV_SEQUENTIAL);
+#endif // PLATFORM_WEB
+            ParseSiteFile((const char*)data, size, sites, error);
+            munmap(data, size);
+        }
+        else
+        {
+            error = {0, "Could not map the file into memory"};
+        }
+    }
+    close(file);
+#endif
+    return (error.message == nullptr);
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: Nearest-site queries that walk the Delaunay graph (the SiteAdjacency of a diagram) instead
+//       of using a separate spatial index. The diagram and adjacency are only ever read, so any
+//       number of threads can query the same diagram at once as long as each one has its own
+//       scratch. The scratch keeps its capacity between queries, so once it has grown to fit,
+//       queries do not allocate.
+struct SiteQueryCandidate
+{
+    float distanceSq;
+    uint32_t site;
+};
+
+struct SiteQueryCandidateComparison
+{
+    bool operator()(const SiteQueryCandidate& lhs, const SiteQueryCandidate& rhs) const
+    {
+        if(lhs.distanceSq != rhs.distanceSq) return lhs.distanceSq > rhs.distanceSq;
+        return lhs.site > rhs.site;
+    }
+};
+
+struct SiteQueryScratch
+{
+    std::vector<SiteQueryCandidate> frontier; // A min-heap of sites that we have reached but not yet returned
+    std::vector<uint32_t> visitedStamp; // visitedStamp[i] == stamp iff site i has been reached in this query
+    uint32_t stamp = 0;
+    uint32_t lastNearestSite = 0; // Where the next query starts its walk from, if it is not given a start
+};
+
+static float GetSiteDistanceSq(const FortuneState& state, uint32_t site, Vector2 point)
+{
+    float dx = state.sites[site].x - point.x;
+    float dy = state.sites[site].y - point.y;
+    return dx*dx + dy*dy;
+}
+
+// NOTE: Returns the site whose cell contains the point, by walking from startSite to whichever
+//       neighbour is closest to the point until there is no closer neighbour. A cell is exactly the
+//       set of points closer to its site than to any of its Delaunay neighbours, so the walk can
+//       only stop at the cell that contains the point.
+uint32_t FindNearestSite(const FortuneState& state, const SiteAdjacency& adjacency, Vector2 point, uint32_t startSite)
+{
+    assert(!state.sites.empty() && (startSite < state.sites.size()));
+    uint32_t current = startSite;
+    float currentDistSq = GetSiteDistanceSq(state, current, point);
+    while(true)
+    {
+        uint32_t next = current;
+        for(uint32_t i=adjacency.firstNeighbour[current]; i<adjacency.firstNeighbour[current+1]; i++)
+        {
+            uint32_t neighbour = adjacency.neighbours[i];
+            float neighbourDistSq = GetSiteDistanceSq(state, neighbour, point);
+            if(neighbourDistSq < currentDistSq)
+            {
+                currentDistSq = neighbourDistSq;
+                next = neighbour;
+            }
+        }
+        if(next == current)
+        {
+            return current;
+        }
+        current = next;
+    }
+}
+
+// NOTE: Outputs sites in order of increasing distance from the point, starting at its nearest site
+//       and growing outwards through neighbouring cells. This finds them all because the (i+1)-th
+//       nearest site is always a Delaunay neighbour of one of the i nearest sites. Stops after
+//       maxCount sites or at the first site further than maxDistanceSq, and returns the count.
+static uint32_t ExpandSitesByDistance(const FortuneState& state, const SiteAdjacency& adjacency, Vector2 point,
+                                      uint32_t maxCount, float maxDistanceSq, SiteQueryScratch& scratch,
+                                      uint32_t* resultSites)
+{
+    if(state.sites.empty() || (maxCount == 0))
+    {
+        return 0;
+    }
+    if(scratch.visitedStamp.size() < state.sites.size())
+    {
+        scratch.visitedStamp.resize(state.sites.size(), 0);
+    }
+    scratch.stamp++;
+    if(scratch.stamp == 0)
+    {
+        std::fill(scratch.visitedStamp.begin(), scratch.visitedStamp.end(), 0);
+        scratch.stamp = 1;
+    }
+    if(scratch.lastNearestSite >= state.sites.size())
+    {
+        scratch.lastNearestSite = 0;
+    }
+
+    SiteQueryCandidateComparison comparison;
+    uint32_t nearest = FindNearestSite(state, adjacency, point, scratch.lastNearestSite);
+    scratch.lastNearestSite = nearest;
+    scratch.frontier.clear();
+    scratch.frontier.push_back({GetSiteDistanceSq(state, nearest, point), nearest});
+    scratch.visitedStamp[nearest] = scratch.stamp;
+
+    uint32_t resultCount = 0;
+    while(!scratch.frontier.empty() && (resultCount < maxCount))
+    {
+        std::pop_heap(scratch.frontier.begin(), scratch.frontier.end(), comparison);
+        SiteQueryCandidate candidate = scratch.frontier.back();
+        scratch.frontier.pop_back();
+        if(candidate.distanceSq > maxDistanceSq)
+        {
+            break;
+        }
+        resultSites[resultCount++] = candidate.site;
+
+        for(uint32_t i=adjacency.firstNeighbour[candidate.site]; i<adjacency.firstNeighbour[candidate.site+1]; i++)
+        {
+            uint32_t neighbour = adjacency.neighbours[i];
+            if(scratch.visitedStamp[neighbour] == scratch.stamp)
+            {
+                continue;
+            }
+            scratch.visitedStamp[neighbour] = scratch.stamp;
+            scratch.frontier.push_back({GetSiteDistanceSq(state, neighbour, point), neighbour});
+            std::push_heap(scratch.frontier.begin(), scratch.frontier.end(), comparison);
+        }
+    }
+    return resultCount;
+}
+
+// NOTE: Writes the (up to) k sites nearest to the point into resultSites, nearest first, and
+//       returns how many were written. Site indices refer to FortuneState::sites.
+uint32_t FindKNearestSites(const FortuneState& state, const SiteAdjacency& adjacency, Vector2 point, uint32_t k,
+                           SiteQueryScratch& scratch, uint32_t* resultSites)
+{
+    return ExpandSitesByDistance(state, adjacency, point, k, FLT_MAX, scratch, resultSites);
+}
+
+// NOTE: Writes the sites within radius of the point into resultSites, nearest first, and returns
+//       how many were written. If there are more than maxResultCount such sites, only the nearest
+//       maxResultCount of them are written.
+uint32_t FindSitesInRadius(const FortuneState& state, const SiteAdjacency& adjacency, Vector2 point, float radius,
+                           SiteQueryScratch& scratch, uint32_t* resultSites, uint32_t maxResultCount)
+{
+    return ExpandSitesByDistance(state, adjacency, point, maxResultCount, radius*radius, scratch, resultSites);
+}
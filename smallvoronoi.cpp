@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: A separate engine for tiny diagrams, where the sweep's event heap, beachline tree and
+//       startup special case cost far more than the geometry itself. Each cell is built directly by
+//       clipping a huge rectangle to the bisector with every other site, using fixed-size arrays on
+//       the stack. That is quadratic in the number of sites but has short, branch-light inner loops,
+//       so it wins comfortably for a few dozen sites.
+//
+//       Every edge of a clipped cell remembers which site's bisector it lies on, so Voronoi vertices
+//       are identified by the three sites whose edges meet there rather than by comparing positions,
+//       and the output has exactly the same shape as the sweep's: shared vertices, with edges that
+//       reach the rectangle becoming open rays. The rectangle is a million times the size of the
+//       sites' bounds, so only vertices of almost-collinear triples of sites fall outside of it.
+const uint32_t MaxSmallDiagramSiteCount = 64;
+const uint32_t MaxSmallCellVertexCount = MaxSmallDiagramSiteCount + 4;
+const double SmallDiagramBoundsScale = 1e6;
+
+struct SmallCellPolygon
+{
+    uint32_t vertexCount;
+    double x[MaxSmallCellVertexCount];
+    double y[MaxSmallCellVertexCount];
+    uint32_t edgeSite[MaxSmallCellVertexCount]; // The site across the edge from vertex k to k+1, or InvalidIndex for the rectangle
+};
+
+// NOTE: Positions are relative to the cell's own site, so the bisector with `other` is the set of
+//       points p where dot(p, other) == |other|^2/2.
+static void ClipSmallCellToBisector(const SmallCellPolygon& polygon, double otherX, double otherY, uint32_t otherSite,
+                                    SmallCellPolygon& clipped)
+{
+    double offset = 0.5*(otherX*otherX + otherY*otherY);
+    double dist[MaxSmallCellVertexCount];
+    bool isAnyOutside = false;
+    for(uint32_t k=0; k<polygon.vertexCount; k++)
+    {
+        dist[k] = polygon.x[k]*otherX + polygon.y[k]*otherY - offset;
+        isAnyOutside |= (dist[k] > 0.0);
+    }
+    if(!isAnyOutside)
+    {
+        clipped = polygon;
+        return;
+    }
+
+    uint32_t clippedCount = 0;
+    for(uint32_t k=0; k<polygon.vertexCount; k++)
+    {
+        uint32_t next = (k+1 < polygon.vertexCount) ? (k+1) : 0;
+        bool isCurrentInside = (dist[k] <= 0.0);
+        bool isNextInside = (dist[next] <= 0.0);
+        if(isCurrentInside)
+        {
+            clipped.x[clippedCount] = polygon.x[k];
+            clipped.y[clippedCount] = polygon.y[k];
+            clipped.edgeSite[clippedCount] = polygon.edgeSite[k];
+            clippedCount++;
+        }
+        if(isCurrentInside != isNextInside)
+        {
+            // NOTE: Leaving the half-plane starts an edge along the bisector, entering it again
+            //       continues along whatever edge we crossed back in on.
+            double t = dist[k]/(dist[k] - dist[next]);
+            clipped.x[clippedCount] = polygon.x[k] + t*(polygon.x[next] - polygon.x[k]);
+            clipped.y[clippedCount] = polygon.y[k] + t*(polygon.y[next] - polygon.y[k]);
+            clipped.edgeSite[clippedCount] = isCurrentInside ? otherSite : polygon.edgeSite[k];
+            clippedCount++;
+        }
+    }
+    assert(clippedCount <= MaxSmallCellVertexCount);
+    clipped.vertexCount = clippedCount;
+}
+
+static uint32_t GetSmallDiagramVertex(FortuneContext& context, uint32_t siteA, uint32_t siteB, uint32_t siteC,
+                                      double x, double y)
+{
+    // Sort the three sites so that each vertex has a single key
+    if(siteA > siteB) std::swap(siteA, siteB);
+    if(siteB > siteC) std::swap(siteB, siteC);
+    if(siteA > siteB) std::swap(siteA, siteB);
+    uint32_t key = (siteA*MaxSmallDiagramSiteCount + siteB)*MaxSmallDiagramSiteCount + siteC;
+
+    std::vector<uint32_t>& keys = context.smallDiagramVertexKeys;
+    for(uint32_t i=0; i<keys.size(); i++)
+    {
+        if(keys[i] == key)
+        {
+            return i;
+        }
+    }
+    keys.push_back(key);
+    context.state.vertices.push_back({(float)x, (float)y});
+    return (uint32_t)(keys.size() - 1);
+}
+
+// NOTE: Computes the complete diagram of sites that have already been prepared with
+//       PrepareFortuneSites, writing the same output as a full run of the sweep would.
+static void ComputeSmallDiagram(FortuneContext& context)
+{
+    FortuneState& state = context.state;
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    assert(siteCount <= MaxSmallDiagramSiteCount);
+    context.smallDiagramVertexKeys.clear();
+
+    double siteX[MaxSmallDiagramSiteCount];
+    double siteY[MaxSmallDiagramSiteCount];
+    double minX = DBL_MAX;
+    double minY = DBL_MAX;
+    double maxX = -DBL_MAX;
+    double maxY = -DBL_MAX;
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        siteX[i] = state.sites[i].x;
+        siteY[i] = state.sites[i].y;
+        minX = std::min(minX, siteX[i]);
+        minY = std::min(minY, siteY[i]);
+        maxX = std::max(maxX, siteX[i]);
+        maxY = std::max(maxY, siteY[i]);
+    }
+    double margin = SmallDiagramBoundsScale*std::max(1.0, std::max(maxX - minX, maxY - minY));
+
+    SmallCellPolygon polygons[2];
+    for(uint32_t site=0; site<siteCount; site++)
+    {
+        // NOTE: The rectangle's corners are listed counter-clockwise, and clipping keeps that order,
+        //       so walking along an edge of the finished cell always has the cell's site on the left.
+        //       That is the same direction as GetEdgeDirection with this site as the left one.
+        SmallCellPolygon* cell = &polygons[0];
+        SmallCellPolygon* clipped = &polygons[1];
+        double cellMinX = minX - margin - siteX[site];
+        double cellMinY = minY - margin - siteY[site];
+        double cellMaxX = maxX + margin - siteX[site];
+        double cellMaxY = maxY + margin - siteY[site];
+        cell->vertexCount = 4;
+        cell->x[0] = cellMinX; cell->y[0] = cellMinY;
+        cell->x[1] = cellMaxX; cell->y[1] = cellMinY;
+        cell->x[2] = cellMaxX; cell->y[2] = cellMaxY;
+        cell->x[3] = cellMinX; cell->y[3] = cellMaxY;
+        for(uint32_t k=0; k<4; k++)
+        {
+            cell->edgeSite[k] = InvalidIndex;
+        }
+
+        for(uint32_t other=0; other<siteCount; other++)
+        {
+            if(other == site) continue;
+            ClipSmallCellToBisector(*cell, siteX[other] - siteX[site], siteY[other] - siteY[site], other, *clipped);
+            std::swap(cell, clipped);
+        }
+
+        // NOTE: Each edge is output once, by the lower-indexed of the two cells that it separates
+        uint32_t vertexCount = cell->vertexCount;
+        for(uint32_t k=0; k<vertexCount; k++)
+        {
+            uint32_t other = cell->edgeSite[k];
+            if((other == InvalidIndex) || (other < site)) continue;
+
+            uint32_t previous = (k > 0) ? (k-1) : (vertexCount-1);
+            uint32_t next = (k+1 < vertexCount) ? (k+1) : 0;
+            uint32_t previousSite = cell->edgeSite[previous];
+            uint32_t nextSite = cell->edgeSite[next];
+
+            CompleteEdge edge;
+            edge.leftSite = site;
+            edge.rightSite = other;
+            edge.vertexA = InvalidIndex;
+            edge.vertexB = InvalidIndex;
+            if(previousSite != InvalidIndex)
+            {
+                edge.vertexA = GetSmallDiagramVertex(context, site, previousSite, other,
+                                                     cell->x[k] + siteX[site], cell->y[k] + siteY[site]);
+            }
+            if(nextSite != InvalidIndex)
+            {
+                edge.vertexB = GetSmallDiagramVertex(context, site, other, nextSite,
+                                                     cell->x[next] + siteX[site], cell->y[next] + siteY[site]);
+            }
+            state.edges.push_back(edge);
+        }
+    }
+}
@@ -0,0 +1,158 @@
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+// NOTE: Publishes diagrams from one writer thread to any number of reader threads without either
+//       side ever taking a lock. The writer builds each new diagram into a snapshot that no reader
+//       can see yet, then swaps it in with a single atomic exchange. Readers pin whichever snapshot
+//       is current when they start, and keep reading that same immutable snapshot until they
+//       release it, no matter how many times the writer publishes in the meantime.
+//
+//       Pinning uses hazard pointers: each reader has a slot that it writes the snapshot it is
+//       about to read into, and then checks that the snapshot is still current (if it is not, the
+//       writer might already have decided it was unused, so the reader just tries again with the
+//       new one). The writer only reuses a retired snapshot once no slot points at it, and reuses
+//       its buffers for the next diagram so that a steady stream of updates does not allocate.
+struct DiagramSnapshot
+{
+    FortuneContext context; // The diagram itself is context.state
+    SiteAdjacency adjacency;
+    uint64_t version;
+};
+
+const uint32_t MaxSnapshotReaders = 64;
+
+struct SnapshotPublisher
+{
+    std::atomic<DiagramSnapshot*> current;
+    std::vector<std::atomic<DiagramSnapshot*>> readerSlots;
+    std::vector<std::atomic<bool>> isReaderSlotTaken;
+
+    // Only touched by the writer
+    std::vector<std::unique_ptr<DiagramSnapshot>> snapshots;
+    std::vector<DiagramSnapshot*> retiredSnapshots;
+    std::vector<DiagramSnapshot*> freeSnapshots;
+    uint64_t nextVersion;
+
+    SnapshotPublisher()
+        : current(nullptr), readerSlots(MaxSnapshotReaders), isReaderSlotTaken(MaxSnapshotReaders), nextVersion(1)
+    {
+        for(uint32_t i=0; i<MaxSnapshotReaders; i++)
+        {
+            readerSlots[i] = nullptr;
+            isReaderSlotTaken[i] = false;
+        }
+    }
+};
+
+// NOTE: Each reader thread needs its own slot, which it keeps for as long as it wants to read.
+//       Returns InvalidIndex if all MaxSnapshotReaders slots are taken.
+uint32_t RegisterSnapshotReader(SnapshotPublisher& publisher)
+{
+    for(uint32_t i=0; i<MaxSnapshotReaders; i++)
+    {
+        bool expected = false;
+        if(publisher.isReaderSlotTaken[i].compare_exchange_strong(expected, true))
+        {
+            return i;
+        }
+    }
+    return InvalidIndex;
+}
+
+void UnregisterSnapshotReader(SnapshotPublisher& publisher, uint32_t reader)
+{
+    assert(publisher.readerSlots[reader].load() == nullptr);
+    publisher.isReaderSlotTaken[reader] = false;
+}
+
+// NOTE: Returns the most recently published snapshot (or nullptr if nothing has been published yet),
+//       which stays valid and unchanged until the reader calls ReleaseSnapshot.
+const DiagramSnapshot* AcquireSnapshot(SnapshotPublisher& publisher, uint32_t reader)
+{
+    std::atomic<DiagramSnapshot*>& slot = publisher.readerSlots[reader];
+    assert(slot.load() == nullptr);
+    DiagramSnapshot* snapshot = publisher.current.load();
+    while(true)
+    {
+        slot.store(snapshot);
+        DiagramSnapshot* latest = publisher.current.load();
+        if(latest == snapshot)
+        {
+            return snapshot;
+        }
+        snapshot = latest;
+    }
+}
+
+void ReleaseSnapshot(SnapshotPublisher& publisher, uint32_t reader)
+{
+    publisher.readerSlots[reader].store(nullptr);
+}
+
+// NOTE: Moves every retired snapshot that no reader has pinned back onto the free list.
+//       Only called by the writer.
+void ReclaimSnapshots(SnapshotPublisher& publisher)
+{
+    size_t keptCount = 0;
+    for(size_t i=0; i<publisher.retiredSnapshots.size(); i++)
+    {
+        DiagramSnapshot* snapshot = publisher.retiredSnapshots[i];
+        bool isPinned = false;
+        for(uint32_t reader=0; (reader<MaxSnapshotReaders) && !isPinned; reader++)
+        {
+            isPinned = (publisher.readerSlots[reader].load() == snapshot);
+        }
+        if(isPinned)
+        {
+            publisher.retiredSnapshots[keptCount++] = snapshot;
+        }
+        else
+        {
+            publisher.freeSnapshots.push_back(snapshot);
+        }
+    }
+    publisher.retiredSnapshots.resize(keptCount);
+}
+
+// NOTE: Returns a snapshot for the writer to build the next diagram into. Readers cannot see it
+//       until it is passed to PublishSnapshot. Its buffers still hold an old diagram, so that
+//       recomputing into them does not need to allocate.
+DiagramSnapshot* BeginSnapshot(SnapshotPublisher& publisher)
+{
+    ReclaimSnapshots(publisher);
+    if(publisher.freeSnapshots.empty())
+    {
+        publisher.snapshots.emplace_back(new DiagramSnapshot());
+        publisher.freeSnapshots.push_back(publisher.snapshots.back().get());
+        publisher.retiredSnapshots.reserve(publisher.snapshots.size());
+        publisher.freeSnapshots.reserve(publisher.snapshots.size());
+    }
+    DiagramSnapshot* result = publisher.freeSnapshots.back();
+    publisher.freeSnapshots.pop_back();
+    return result;
+}
+
+// NOTE: Makes the snapshot visible to readers that acquire a snapshot from now on. The snapshot
+//       must not be modified after this.
+void PublishSnapshot(SnapshotPublisher& publisher, DiagramSnapshot* snapshot)
+{
+    snapshot->version = publisher.nextVersion++;
+    DiagramSnapshot* previous = publisher.current.exchange(snapshot);
+    if(previous != nullptr)
+    {
+        publisher.retiredSnapshots.push_back(previous);
+    }
+    ReclaimSnapshots(publisher);
+}
+
+// NOTE: Computes a diagram (and its adjacency) into a fresh snapshot and publishes it.
+void ComputeAndPublishSnapshot(SnapshotPublisher& publisher, const std::vector<Vector2>& sites)
+{
+    DiagramSnapshot* snapshot = BeginSnapshot(publisher);
+    const FortuneState& state = FortunesAlgorithm(snapshot->context, sites, -FLT_MAX);
+    BuildSiteAdjacency(state, snapshot->adjacency);
+    PublishSnapshot(publisher, snapshot);
+}
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <iterator>
+#include <list>
+#include <math.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+// NOTE: The part of the global diagram that lies inside one square tile of the world.
+//       cells holds (clipped to the tile) the cell of every site whose cell overlaps the tile,
+//       and cells.sites[i] is the global site siteIds[i].
+struct VoronoiTile
+{
+    int32_t tileX;
+    int32_t tileY;
+    float haloSize; // How far beyond the tile we needed to look for sites to get the tile right
+    std::vector<uint32_t> siteIds;
+    VoronoiCells cells;
+};
+
+// NOTE: Computes the tiles of the diagram of a (potentially very large) set of sites on demand,
+//       and keeps up to `capacity` of the most recently requested tiles around.
+//       Tile (x,y) covers origin + tileSize*[x, x+1) by origin + tileSize*[y, y+1).
+struct VoronoiTileCache
+{
+    std::vector<Vector2> sites;
+    Vector2 siteMin;
+    Vector2 siteMax;
+    Vector2 origin;
+    float tileSize;
+    size_t capacity;
+
+    // Sites bucketed (in order of global index) into a grid aligned with the tiles
+    int32_t firstBucketX;
+    int32_t firstBucketY;
+    int32_t bucketCountX;
+    int32_t bucketCountY;
+    std::vector<uint32_t> bucketStart;
+    std::vector<uint32_t> bucketSites;
+
+    std::list<VoronoiTile> tiles; // Most recently used first
+    std::unordered_map<uint64_t, std::list<VoronoiTile>::iterator> tileLookup;
+
+    // Scratch space for computing tiles
+    FortuneContext context;
+    SiteAdjacency adjacency;
+    std::vector<Vector2> localSites;
+    std::vector<uint32_t> localSiteIds;
+    std::vector<uint32_t> uniqueSiteIds;
+    VoronoiCells localCells;
+};
+
+static uint64_t GetTileKey(int32_t tileX, int32_t tileY)
+{
+    return ((uint64_t)(uint32_t)tileX << 32) | (uint64_t)(uint32_t)tileY;
+}
+
+static int32_t GetTileCoord(float value, float origin, float tileSize)
+{
+    return (int32_t)floorf((value - origin)/tileSize);
+}
+
+void InitialiseVoronoiTileCache(VoronoiTileCache& cache, const std::vector<Vector2>& sites, Vector2 origin, float tileSize, size_t capacity)
+{
+    assert((tileSize > 0.0f) && (capacity > 0));
+    cache.sites = sites;
+    cache.origin = origin;
+    cache.tileSize = tileSize;
+    cache.capacity = capacity;
+    cache.tiles.clear();
+    cache.tileLookup.clear();
+    cache.tileLookup.reserve(capacity);
+
+    cache.siteMin = {FLT_MAX, FLT_MAX};
+    cache.siteMax = {-FLT_MAX, -FLT_MAX};
+    for(Vector2 site : sites)
+    {
+        cache.siteMin.x = min(cache.siteMin.x, site.x);
+        cache.siteMin.y = min(cache.siteMin.y, site.y);
+        cache.siteMax.x = max(cache.siteMax.x, site.x);
+        cache.siteMax.y = max(cache.siteMax.y, site.y);
+    }
+    if(sites.empty())
+    {
+        cache.siteMin = origin;
+        cache.siteMax = origin;
+    }
+
+    cache.firstBucketX = GetTileCoord(cache.siteMin.x, origin.x, tileSize);
+    cache.firstBucketY = GetTileCoord(cache.siteMin.y, origin.y, tileSize);
+    cache.bucketCountX = GetTileCoord(cache.siteMax.x, origin.x, tileSize) - cache.firstBucketX + 1;
+    cache.bucketCountY = GetTileCoord(cache.siteMax.y, origin.y, tileSize) - cache.firstBucketY + 1;
+    size_t bucketCount = (size_t)cache.bucketCountX*(size_t)cache.bucketCountY;
+
+    // Counting-sort the sites into their buckets
+    std::vector<uint32_t> siteBucket(sites.size());
+    cache.bucketStart.assign(bucketCount + 1, 0);
+    cache.bucketSites.resize(sites.size());
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        int32_t bucketX = GetTileCoord(sites[i].x, origin.x, tileSize) - cache.firstBucketX;
+        int32_t bucketY = GetTileCoord(sites[i].y, origin.y, tileSize) - cache.firstBucketY;
+        bucketX = (bucketX < 0) ? 0 : ((bucketX >= cache.bucketCountX) ? cache.bucketCountX-1 : bucketX);
+        bucketY = (bucketY < 0) ? 0 : ((bucketY >= cache.bucketCountY) ? cache.bucketCountY-1 : bucketY);
+        siteBucket[i] = (uint32_t)(bucketY*cache.bucketCountX + bucketX);
+        cache.bucketStart[siteBucket[i] + 1]++;
+    }
+    for(size_t i=0; i<bucketCount; i++)
+    {
+        cache.bucketStart[i+1] += cache.bucketStart[i];
+    }
+    std::vector<uint32_t> bucketFill(cache.bucketStart.begin(), cache.bucketStart.end()-1);
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        cache.bucketSites[bucketFill[siteBucket[i]]++] = (uint32_t)i;
+    }
+}
+
+// NOTE: Collects (in order of global index) every site in the given rectangle.
+static void GatherTileSites(VoronoiTileCache& cache, Vector2 minCorner, Vector2 maxCorner)
+{
+    cache.localSites.clear();
+    cache.localSiteIds.clear();
+    int32_t firstX = GetTileCoord(minCorner.x, cache.origin.x, cache.tileSize) - cache.firstBucketX;
+    int32_t firstY = GetTileCoord(minCorner.y, cache.origin.y, cache.tileSize) - cache.firstBucketY;
+    int32_t lastX = GetTileCoord(maxCorner.x, cache.origin.x, cache.tileSize) - cache.firstBucketX;
+    int32_t lastY = GetTileCoord(maxCorner.y, cache.origin.y, cache.tileSize) - cache.firstBucketY;
+    if(firstX < 0) firstX = 0;
+    if(firstY < 0) firstY = 0;
+    if(lastX >= cache.bucketCountX) lastX = cache.bucketCountX-1;
+    if(lastY >= cache.bucketCountY) lastY = cache.bucketCountY-1;
+
+    for(int32_t bucketY=firstY; bucketY<=lastY; bucketY++)
+    {
+        for(int32_t bucketX=firstX; bucketX<=lastX; bucketX++)
+        {
+            int32_t bucket = bucketY*cache.bucketCountX + bucketX;
+            for(uint32_t i=cache.bucketStart[bucket]; i<cache.bucketStart[bucket+1]; i++)
+            {
+                Vector2 site = cache.sites[cache.bucketSites[i]];
+                if((site.x >= minCorner.x) && (site.x <= maxCorner.x) &&
+                   (site.y >= minCorner.y) && (site.y <= maxCorner.y))
+                {
+                    cache.localSiteIds.push_back(cache.bucketSites[i]);
+                }
+            }
+        }
+    }
+
+    // NOTE: Keeping the sites in global order means that every cell gets clipped against its
+    //       neighbours in the same order as it would be in the global diagram.
+    std::sort(cache.localSiteIds.begin(), cache.localSiteIds.end());
+    for(uint32_t siteId : cache.localSiteIds)
+    {
+        cache.localSites.push_back(cache.sites[siteId]);
+    }
+}
+
+// NOTE: Computes a tile from the sites within haloSize of it.
+//       For every point p in the tile, a site more than haloSize outside the tile is more than
+//       haloSize away from p. So if every point of each (local) cell in the tile is within haloSize
+//       of its site, then no site that we left out could be closer, and the tile is exact.
+//       Cells are convex, so it is enough to check their vertices. If the check fails we grow the
+//       halo to the distance that would have been needed and try again. Adding sites only shrinks
+//       the cells, so the second attempt always succeeds.
+static void ComputeVoronoiTile(VoronoiTileCache& cache, VoronoiTile& tile)
+{
+    Vector2 tileMin = {cache.origin.x + (float)tile.tileX*cache.tileSize,
+                       cache.origin.y + (float)tile.tileY*cache.tileSize};
+    Vector2 tileMax = {tileMin.x + cache.tileSize, tileMin.y + cache.tileSize};
+
+    float haloSize = cache.tileSize;
+    while(true)
+    {
+        Vector2 haloMin = {tileMin.x - haloSize, tileMin.y - haloSize};
+        Vector2 haloMax = {tileMax.x + haloSize, tileMax.y + haloSize};
+        bool containsAllSites = (haloMin.x <= cache.siteMin.x) && (haloMin.y <= cache.siteMin.y) &&
+                                (haloMax.x >= cache.siteMax.x) && (haloMax.y >= cache.siteMax.y);
+        GatherTileSites(cache, haloMin, haloMax);
+        if(cache.localSites.empty() && !containsAllSites)
+        {
+            haloSize *= 2.0f;
+            continue;
+        }
+
+        const FortuneState& state = FortunesAlgorithm(cache.context, cache.localSites, -FLT_MAX);
+        BuildSiteAdjacency(state, cache.adjacency);
+        BuildClippedCells(state, cache.adjacency, tileMin, tileMax, cache.localCells);
+
+        float requiredHaloSq = 0.0f;
+        for(size_t cell=0; cell<state.sites.size(); cell++)
+        {
+            Vector2 site = state.sites[cell];
+            for(uint32_t i=cache.localCells.firstVertex[cell]; i<cache.localCells.firstVertex[cell+1]; i++)
+            {
+                Vector2 offset = {cache.localCells.vertices[i].x - site.x, cache.localCells.vertices[i].y - site.y};
+                requiredHaloSq = max(requiredHaloSq, offset.x*offset.x + offset.y*offset.y);
+            }
+        }
+        float requiredHalo = sqrtf(requiredHaloSq);
+        if(containsAllSites || (requiredHalo <= haloSize))
+        {
+            break;
+        }
+        haloSize = 1.001f*requiredHalo;
+    }
+    tile.haloSize = haloSize;
+
+    // NOTE: Duplicate sites get merged into the first of them, so the unique sites appear in order
+    //       of their first occurrence in the input.
+    const FortuneState& state = cache.context.state;
+    cache.uniqueSiteIds.clear();
+    for(size_t i=0; i<state.canonicalSite.size(); i++)
+    {
+        if(state.canonicalSite[i] == cache.uniqueSiteIds.size())
+        {
+            cache.uniqueSiteIds.push_back(cache.localSiteIds[i]);
+        }
+    }
+
+    // Only keep the cells that actually overlap the tile
+    tile.siteIds.clear();
+    tile.cells.minCorner = tileMin;
+    tile.cells.maxCorner = tileMax;
+    tile.cells.sites.clear();
+    tile.cells.firstVertex.clear();
+    tile.cells.vertices.clear();
+    for(size_t cell=0; cell<state.sites.size(); cell++)
+    {
+        uint32_t begin = cache.localCells.firstVertex[cell];
+        uint32_t end = cache.localCells.firstVertex[cell+1];
+        if(begin == end)
+        {
+            continue;
+        }
+        tile.siteIds.push_back(cache.uniqueSiteIds[cell]);
+        tile.cells.sites.push_back(state.sites[cell]);
+        tile.cells.firstVertex.push_back((uint32_t)tile.cells.vertices.size());
+        tile.cells.vertices.insert(tile.cells.vertices.end(),
+                                   cache.localCells.vertices.begin() + begin,
+                                   cache.localCells.vertices.begin() + end);
+    }
+    tile.cells.firstVertex.push_back((uint32_t)tile.cells.vertices.size());
+}
+
+// NOTE: Returns the requested tile, computing it if it is not already in the cache.
+//       The returned reference is only valid until the next call with the same cache, since that
+//       call might evict it. Evicted tiles have their buffers reused for the new tile.
+const VoronoiTile& GetVoronoiTile(VoronoiTileCache& cache, int32_t tileX, int32_t tileY)
+{
+    uint64_t key = GetTileKey(tileX, tileY);
+    auto existing = cache.tileLookup.find(key);
+    if(existing != cache.tileLookup.end())
+    {
+        cache.tiles.splice(cache.tiles.begin(), cache.tiles, existing->second);
+        return cache.tiles.front();
+    }
+
+    if(cache.tiles.size() >= cache.capacity)
+    {
+        VoronoiTile& evicted = cache.tiles.back();
+        cache.tileLookup.erase(GetTileKey(evicted.tileX, evicted.tileY));
+        cache.tiles.splice(cache.tiles.begin(), cache.tiles, std::prev(cache.tiles.end()));
+    }
+    else
+    {
+        cache.tiles.emplace_front();
+    }
+
+    VoronoiTile& tile = cache.tiles.front();
+    tile.tileX = tileX;
+    tile.tileY = tileY;
+    ComputeVoronoiTile(cache, tile);
+    cache.tileLookup[key] = cache.tiles.begin();
+    return tile;
+}
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// NOTE: Records timed scopes into a fixed-size buffer and writes them out in the Chrome Trace Event
+//       format, which can be opened in chrome://tracing or ui.perfetto.dev. Recording only happens
+//       between StartTraceCapture and StopTraceCapture, and scopes are just dropped once the buffer
+//       is full, so leaving the timers in costs next to nothing when we are not capturing.
+//       Scopes can be recorded from any thread, and each one claims its slot in the buffer with
+//       a single atomic increment.
+struct TraceEvent
+{
+    const char* name; // Must be a string literal (or otherwise outlive the capture)
+    int64_t startMicroseconds;
+    int64_t durationMicroseconds;
+    uint32_t threadId;
+};
+
+struct TraceCapture
+{
+    std::vector<TraceEvent> events;
+    std::atomic<uint32_t> eventCount;
+    std::atomic<bool> isCapturing;
+    std::chrono::steady_clock::time_point origin;
+};
+
+static TraceCapture globalTraceCapture;
+
+static int64_t GetTraceTimestamp()
+{
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - globalTraceCapture.origin;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+static uint32_t GetTraceThreadId()
+{
+    static std::atomic<uint32_t> nextThreadId(1);
+    thread_local uint32_t threadId = nextThreadId.fetch_add(1);
+    return threadId;
+}
+
+void StartTraceCapture(uint32_t maxEventCount)
+{
+    globalTraceCapture.isCapturing = false;
+    globalTraceCapture.events.resize(maxEventCount);
+    globalTraceCapture.eventCount = 0;
+    globalTraceCapture.origin = std::chrono::steady_clock::now();
+    globalTraceCapture.isCapturing = true;
+}
+
+// NOTE: Stops capturing and writes everything that was captured to the given file.
+//       Must not be called while another thread might still be inside a traced scope.
+bool StopTraceCapture(const char* filename)
+{
+    globalTraceCapture.isCapturing = false;
+    FILE* traceFile = fopen(filename, "w");
+    if(traceFile == nullptr)
+    {
+        return false;
+    }
+
+    uint32_t eventCount = globalTraceCapture.eventCount;
+    if(eventCount > globalTraceCapture.events.size())
+    {
+        eventCount = (uint32_t)globalTraceCapture.events.size();
+    }
+    fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(uint32_t i=0; i<eventCount; i++)
+    {
+        const TraceEvent& evt = globalTraceCapture.events[i];
+        fprintf(traceFile, "{\"name\":\"%s\",\"cat\":\"fortune\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u}%s\n",
+                evt.name, (long long)evt.startMicroseconds, (long long)evt.durationMicroseconds,
+                evt.threadId, (i+1 < eventCount) ? "," : "");
+    }
+    fprintf(traceFile, "]}\n");
+    fclose(traceFile);
+    return true;
+}
+
+static void RecordTraceEvent(const char* name, int64_t startMicroseconds)
+{
+    int64_t endMicroseconds = GetTraceTimestamp();
+    uint32_t slot = globalTraceCapture.eventCount.fetch_add(1);
+    if(slot < globalTraceCapture.events.size())
+    {
+        TraceEvent& evt = globalTraceCapture.events[slot];
+        evt.name = name;
+        evt.startMicroseconds = startMicroseconds;
+        evt.durationMicroseconds = endMicroseconds - startMicroseconds;
+        evt.threadId = GetTraceThreadId();
+    }
+}
+
+// NOTE: Times from construction until destruction.
+struct TraceScope
+{
+    const char* name;
+    int64_t startMicroseconds;
+
+    TraceScope(const char* scopeName) : name(nullptr), startMicroseconds(0)
+    {
+        if(globalTraceCapture.isCapturing)
+        {
+            name = scopeName;
+            startMicroseconds = GetTraceTimestamp();
+        }
+    }
+    ~TraceScope()
+    {
+        if(name != nullptr)
+        {
+            RecordTraceEvent(name, startMicroseconds);
+        }
+    }
+};
+
+// NOTE: Times a sequence of back-to-back phases, where starting each phase ends the previous one
+//       and the last one ends when the TracePhases goes out of scope.
+struct TracePhases
+{
+    const char* name;
+    int64_t startMicroseconds;
+
+    TracePhases() : name(nullptr), startMicroseconds(0) {}
+    ~TracePhases()
+    {
+        End();
+    }
+
+    void Begin(const char* phaseName)
+    {
+        End();
+        if(globalTraceCapture.isCapturing)
+        {
+            name = phaseName;
+            startMicroseconds = GetTraceTimestamp();
+        }
+    }
+
+    void End()
+    {
+        if(name != nullptr)
+        {
+            RecordTraceEvent(name, startMicroseconds);
+            name = nullptr;
+        }
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
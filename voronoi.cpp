@@ -1,85 +1,60 @@
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <float.h>
 #include <math.h>
-#include <queue>
+#include <stdint.h>
 #include <stdio.h>
 #include <vector>
 
-enum class BeachlineItemType
+#include "trace.cpp"
+#include "perfcounters.cpp"
+
+const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+enum class BeachlineItemType : uint8_t
 {
     None,
     Arc,
     Edge
 };
-struct Edge
-{
-    Vector2 start;
-    Vector2 direction;
-    bool extendsUpwardsForever;
-};
+// NOTE: Output edges refer to their endpoints by index into FortuneState::vertices, so that each
+//       Voronoi vertex is only stored once no matter how many edges meet at it. An endpoint of
+//       InvalidIndex is an open ray that extends to infinity (or, if the sweep was stopped before
+//       it finished, an endpoint that the sweep has not reached yet). leftSite and rightSite are
+//       the indices of the two sites that the edge separates, as seen when walking from A to B.
 struct CompleteEdge
 {
-    Vector2 endpointA;
-    Vector2 endpointB;
+    uint32_t vertexA;
+    uint32_t vertexB;
+    uint32_t leftSite;
+    uint32_t rightSite;
 };
 
-struct SweepEvent;
-struct Arc
+// NOTE: The beachline is a binary tree whose leaves are arcs and whose internal nodes are the edges
+//       between adjacent arcs. Rather than allocating each node separately, the nodes are stored
+//       as a structure-of-arrays and addressed by 32-bit indices. The fields that are read on every
+//       step of the descent in GetActiveArcForXCoord (the node type and the arc foci)
+//       live in separate arrays from the tree topology and the event bookkeeping, so that point
+//       location touches as few cache lines as possible.
+struct Beachline
 {
-    Vector2 focus;
-    SweepEvent* squeezeEvent;
-};
-
-struct BeachlineItem
-{
-    BeachlineItemType type;
-    union
-    {
-        Arc arc;
-        Edge edge;
-    };
-
-    BeachlineItem* parent;
-    BeachlineItem* left;
-    BeachlineItem* right;
-
-    BeachlineItem() : parent(nullptr), left(nullptr), right(nullptr) {}
-
-    void SetLeft(BeachlineItem* newLeft)
-    {
-        assert(type == BeachlineItemType::Edge);
-        assert(newLeft != nullptr);
-        left = newLeft;
-        newLeft->parent = this;
-    }
-
-    void SetRight(BeachlineItem* newRight)
-    {
-        assert(type == BeachlineItemType::Edge);
-        assert(newRight != nullptr);
-        right = newRight;
-        newRight->parent = this;
-    }
-
-    void SetParentFromItem(BeachlineItem* item)
-    {
-        assert(item != nullptr);
-        if(item->parent == nullptr)
-        {
-            parent = nullptr;
-            return;
-        }
-
-        if(item->parent->left == item)
-        {
-            item->parent->SetLeft(this);
-        }
-        else
-        {
-            assert(item->parent->right == item);
-            item->parent->SetRight(this);
-        }
-    }
+    std::vector<BeachlineItemType> type;
+    std::vector<Vector2> point; // The focus of an arc, or the start point of an edge
+    std::vector<Vector2> direction; // Only used by edges
+
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> left;
+    std::vector<uint32_t> right;
+    std::vector<uint32_t> squeezeEvent; // Only used by arcs, indexes into FortuneContext::events
+    std::vector<uint32_t> site; // Only used by arcs, indexes into FortuneState::sites
+    std::vector<uint32_t> outputEdge; // Only used by edges, indexes into FortuneState::edges
+    std::vector<uint8_t> finishesAtVertexA; // Only used by edges, which end of outputEdge this edge traces out
+
+    std::vector<uint32_t> freeItems;
+    uint32_t root;
+
+    Beachline() : root(InvalidIndex) {}
 };
 
 enum class SweepEventType
@@ -91,11 +66,12 @@ enum class SweepEventType
 struct NewPointEvent
 {
     Vector2 point;
+    uint32_t site;
 };
 struct EdgeIntersectionEvent
 {
     Vector2 intersectionPoint;
-    BeachlineItem* squeezedArc;
+    uint32_t squeezedArc;
     bool isValid;
 };
 struct SweepEvent
@@ -110,49 +86,116 @@ struct SweepEvent
 };
 
 #include "vtree.cpp"
+#include "dedupe.cpp"
 
 struct FortuneState
 {
+    // NOTE: The sites that the diagram was built from, after merging duplicates.
+    //       canonicalSite maps the index of each input site to its index in this array.
+    std::vector<Vector2> sites;
+    std::vector<uint32_t> canonicalSite;
+
     float sweepY;
-    std::vector<CompleteEdge*> edges;
-    std::vector<SweepEvent*> unencounteredEvents;
-    BeachlineItem* beachlineRoot;
+    std::vector<Vector2> vertices;
+    std::vector<CompleteEdge> edges;
+    std::vector<SweepEvent> unencounteredEvents;
+    Beachline beachline;
 };
 
-struct EventComparison : std::binary_function<SweepEvent, SweepEvent, bool>
+#include "locality.cpp"
+
+struct EventComparison
 {
-    bool operator()(const SweepEvent* lhs, const SweepEvent* rhs) const
+    const SweepEvent* events;
+
+    bool operator()(uint32_t lhs, uint32_t rhs) const
     {
-        assert((lhs != nullptr) && (rhs != nullptr));
-        return lhs->yCoord < rhs->yCoord;
+        return events[lhs].yCoord < events[rhs].yCoord;
     }
 };
 
-float GetArcYForXCoord(Arc& arc, float x, float directrixY)
+// NOTE: Lets other threads follow a sweep as it runs, and stop it early (see async.cpp).
+//       progress is how far the sweep line has got through the y range of the sites, from 0 to 1.
+//       Cancellation is checked every few thousand sites while the sites are prepared, and before
+//       every event of the sweep. A cancelled preparation leaves no sites, and a cancelled sweep
+//       leaves no vertices or edges, so a cancelled run always ends with an empty diagram.
+struct FortuneSweepControl
+{
+    std::atomic<bool> isCancelRequested;
+    std::atomic<float> progress;
+
+    FortuneSweepControl() : isCancelRequested(false), progress(0.0f) {}
+};
+
+// NOTE: Everything that FortunesAlgorithm needs to allocate lives in here, so that a context that
+//       is kept around between runs keeps the capacity of all of its buffers and repeatedly
+//       computing diagrams of a similar size does not need to touch the heap at all.
+struct FortuneContext
+{
+    FortuneState state;
+
+    // NOTE: Input sites closer together than this are merged before the sweep runs, because
+    //       coincident sites would otherwise produce degenerate (zero-length) bisectors.
+    float siteMergeEpsilon = 1e-3f;
+    std::vector<SiteHashEntry> siteHashTable;
+    std::vector<uint32_t> siteOrder; // Indices into state.sites, in the order that the sweep reaches them
+
+    // NOTE: Complete diagrams with fewer sites than this skip the sweep and are built by clipping
+    //       each cell separately instead (see smallvoronoi.cpp). Must be at most MaxSmallDiagramSiteCount.
+    uint32_t smallDiagramSiteCount = 32;
+    std::vector<uint32_t> smallDiagramVertexKeys;
+
+    // NOTE: The arc added by the previous site event, where the next one starts looking for the arc
+    //       that it lands on (see GetActiveArcFromFinger). Consecutive sites are often close in x.
+    uint32_t fingerArc = InvalidIndex;
+
+    FortuneSweepControl* control = nullptr; // Optional, and not owned by the context
+    SweepPerfCounters* perfCounters = nullptr; // Optional, and not owned by the context
+
+    // NOTE: When set, each diagram is swept along whichever axis is expected to give the shorter
+    //       beachline (see ChooseSweepAxis), which for inputs that are much wider than they are tall
+    //       is x rather than y. The output is the same either way. isSweepAlongX says which was used.
+    bool chooseSweepAxis = false;
+    bool isSweepAlongX = false;
+    std::vector<uint32_t> sweepAxisHistogram;
+
+    // NOTE: When set, finished diagrams have their sites, vertices and edges renumbered along a
+    //       Hilbert curve (see locality.cpp) and `reordering` holds the permutations that were applied.
+    bool reorderForLocality = false;
+    FortuneReordering reordering;
+
+    std::vector<SweepEvent> events;
+    std::vector<uint32_t> freeEvents;
+    std::vector<uint32_t> eventQueue; // A binary heap of indices into events
+};
+
+#include "smallvoronoi.cpp"
+
+float GetArcYForXCoord(Vector2 focus, float x, float directrixY)
 {
     // NOTE: In the interest of keeping the formula simple when moving away from the origin,
     //       we'll use the substitution from (x,y) -> (w,y) = (x-focusX,y).
     //       In particular this substitution means that the formula always has the form:
     //       y = aw^2 + c, the linear term's coefficient is always 0.
-    float a = 1.0f/(2.0f*(arc.focus.y - directrixY));
-    float c = (arc.focus.y + directrixY)*0.5f;
+    float a = 1.0f/(2.0f*(focus.y - directrixY));
+    float c = (focus.y + directrixY)*0.5f;
 
-    float w = x - arc.focus.x;
+    float w = x - focus.x;
     return a*w*w + c;
 }
 
-bool GetEdgeArcIntersectionPoint(Edge& edge, Arc& arc, float directrixY, Vector2& intersectionPt)
+bool GetEdgeArcIntersectionPoint(Vector2 edgeStart, Vector2 edgeDirection, Vector2 focus, float directrixY, Vector2& intersectionPt)
 {
     // Special case 1: Edge is a vertical line.
-    if(edge.direction.x == 0.0f)
+    if(edgeDirection.x == 0.0f)
     {
-        if(directrixY == arc.focus.y)
+        if(directrixY == focus.y)
         {
             // Special case A of special case 1: The arc's focus is on the directrix line, so the arc is essentially a vertical line
-            if(edge.start.x == arc.focus.x)
+            if(edgeStart.x == focus.x)
             {
                 // TODO: What is the correct Y-value to use here?
-                intersectionPt = arc.focus;
+                intersectionPt = focus;
                 return true;
             }
             else
@@ -160,34 +203,34 @@ bool GetEdgeArcIntersectionPoint(Edge& edge, Arc& arc, float directrixY, Vector2
                 return false;
             }
         }
-        float arcY = GetArcYForXCoord(arc, edge.start.x, directrixY);
-        intersectionPt = {edge.start.x, arcY};
+        float arcY = GetArcYForXCoord(focus, edgeStart.x, directrixY);
+        intersectionPt = {edgeStart.x, arcY};
         return true;
     }
 
     // y = px + q
-    float p = edge.direction.y/edge.direction.x;
-    float q = edge.start.y - p*edge.start.x;
+    float p = edgeDirection.y/edgeDirection.x;
+    float q = edgeStart.y - p*edgeStart.x;
 
-    // Special case 2: Arc is currently a vertical line (directrixY == arc.focus.y)
-    if(arc.focus.y == directrixY)
+    // Special case 2: Arc is currently a vertical line (directrixY == focus.y)
+    if(focus.y == directrixY)
     {
-        float intersectionXOffset = arc.focus.x - edge.start.x;
+        float intersectionXOffset = focus.x - edgeStart.x;
         // Check if the intersection is in the direction that the edge is going. If not then no intersect
-        if(intersectionXOffset * edge.direction.x < 0)
+        if(intersectionXOffset * edgeDirection.x < 0)
         {
             return false;
         }
 
-        intersectionPt.x = arc.focus.x;
-        intersectionPt.y = p*arc.focus.x + q;
+        intersectionPt.x = focus.x;
+        intersectionPt.y = p*focus.x + q;
         return true;
     }
 
     // y = a_0 + a_1x + a_2x^2
-    float a2 = 1.0f/(2.0f*(arc.focus.y - directrixY));
-    float a1 = -p - 2.0f*a2*arc.focus.x;
-    float a0 = a2*arc.focus.x*arc.focus.x + (arc.focus.y + directrixY)*0.5f - q;
+    float a2 = 1.0f/(2.0f*(focus.y - directrixY));
+    float a1 = -p - 2.0f*a2*focus.x;
+    float a0 = a2*focus.x*focus.x + (focus.y + directrixY)*0.5f - q;
 
     float discriminant = a1*a1 - 4.0f*a2*a0;
     if(discriminant < 0)
@@ -198,10 +241,10 @@ bool GetEdgeArcIntersectionPoint(Edge& edge, Arc& arc, float directrixY, Vector2
     float x1 = (-a1 + rootDisc)/(2.0f*a2);
     float x2 = (-a1 - rootDisc)/(2.0f*a2);
 
-    float x1Offset = x1 - edge.start.x;
-    float x2Offset = x2 - edge.start.x;
-    float x1Dot = x1Offset * edge.direction.x;
-    float x2Dot = x2Offset * edge.direction.x;
+    float x1Offset = x1 - edgeStart.x;
+    float x2Offset = x2 - edgeStart.x;
+    float x1Dot = x1Offset * edgeDirection.x;
+    float x2Dot = x2Offset * edgeDirection.x;
 
     float x;
     if((x1Dot >= 0.0f) && (x2Dot < 0.0f)) x = x1;
@@ -217,453 +260,1018 @@ bool GetEdgeArcIntersectionPoint(Edge& edge, Arc& arc, float directrixY, Vector2
         else x = x1;
     }
 
-    float y = GetArcYForXCoord(arc, x, directrixY);
+    float y = GetArcYForXCoord(focus, x, directrixY);
     assert(isfinite(y));
     intersectionPt = {x,y};
     return true;
 }
 
-BeachlineItem* GetActiveArcForXCoord(BeachlineItem* root, float x, float directrixY)
-{
-    BeachlineItem* currentItem = root;
-    while(currentItem->type != BeachlineItemType::Arc)
-    {
-        assert(currentItem->type == BeachlineItemType::Edge);
-        BeachlineItem* left = GetFirstLeafOnTheLeft(currentItem);
-        BeachlineItem* right = GetFirstLeafOnTheRight(currentItem);
-        assert((left != nullptr) && (left->type == BeachlineItemType::Arc));
-        assert((right != nullptr) && (right->type == BeachlineItemType::Arc));
-
-        BeachlineItem* fromLeft = GetFirstParentOnTheRight(left);
-        BeachlineItem* fromRight = GetFirstParentOnTheLeft(right);
-        assert((fromLeft != nullptr) && (fromLeft == fromRight));
-        assert(fromLeft->type == BeachlineItemType::Edge);
-        Edge& separatingEdge = fromLeft->edge;
-
-        Vector2 leftIntersect;
-        Vector2 rightIntersect;
-        bool didLeftIntersect = GetEdgeArcIntersectionPoint(separatingEdge, left->arc, directrixY, leftIntersect);
-        bool didRightIntersect = GetEdgeArcIntersectionPoint(separatingEdge, right->arc, directrixY, rightIntersect);
-
-#if 0
-        // TODO: These should all pass as far as I can tell, but precision issues cause that not to be the case.
-        assert(didLeftIntersect && didRightIntersect);
-        assert(abs(leftIntersect.x - rightIntersect.x) < 1.0f);
-        assert(didLeftIntersect || didRightIntersect);
-#endif
-        float intersectionX = leftIntersect.x;
-        if(!didLeftIntersect && didRightIntersect)
-        {
-            intersectionX = rightIntersect.x;
-        }
+// NOTE: Returns the x coordinate at which the arc with focus `left` meets the arc with focus `right`
+//       on its right-hand side. This comes straight from the two foci rather than from the edge
+//       between them, since that edge only gets a start point when it is created and intersecting
+//       it with a very narrow arc (one whose focus is barely above the directrix) loses most of its
+//       precision. Setting the two parabolas equal and writing x = left.x + u gives
+//       (dr - dl)u^2 + 2*dl*D*u - dl*(D^2 + dr*(dr - dl)) = 0, where dl and dr are the heights of the
+//       foci above the directrix and D = right.x - left.x. The breakpoint with the left arc on the
+//       left is the root (-b + sqrt(b^2 - 4ac))/2a, which is rearranged when b > 0 to avoid
+//       cancellation. Everything is done in doubles since the terms grow with the square of D.
+double GetBreakpointXCoord(Vector2 left, Vector2 right, float directrixY)
+{
+    double dl = (double)left.y - (double)directrixY;
+    double dr = (double)right.y - (double)directrixY;
+    if(dl <= 0.0) return left.x;
+    if(dr <= 0.0) return right.x;
+
+    double D = (double)right.x - (double)left.x;
+    double a = dr - dl;
+    double b = 2.0*dl*D;
+    double c = -dl*(D*D + dr*a);
+    if(a == 0.0)
+    {
+        return (double)left.x + 0.5*D;
+    }
+    double discriminant = b*b - 4.0*a*c;
+    double rootDisc = (discriminant > 0.0) ? sqrt(discriminant) : 0.0;
+    double u;
+    if(b > 0.0)
+    {
+        u = (2.0*c)/(-b - rootDisc);
+    }
+    else
+    {
+        u = (rootDisc - b)/(2.0*a);
+    }
+    return (double)left.x + u;
+}
 
-        if(x < intersectionX)
+static double GetEdgeBreakpointXCoord(const Beachline& beachline, uint32_t edge, float directrixY)
+{
+    assert(beachline.type[edge] == BeachlineItemType::Edge);
+    uint32_t left = GetFirstLeafOnTheLeft(beachline, edge);
+    uint32_t right = GetFirstLeafOnTheRight(beachline, edge);
+    assert((left != InvalidIndex) && (beachline.type[left] == BeachlineItemType::Arc));
+    assert((right != InvalidIndex) && (beachline.type[right] == BeachlineItemType::Arc));
+    return GetBreakpointXCoord(beachline.point[left], beachline.point[right], directrixY);
+}
+
+// NOTE: Descends from any item in the tree to the arc in its subtree that is above x, assuming that
+//       x is somewhere within the range covered by that subtree.
+static uint32_t GetActiveArcInSubtree(const Beachline& beachline, uint32_t subtreeRoot, float x, float directrixY)
+{
+    uint32_t currentItem = subtreeRoot;
+    while(beachline.type[currentItem] != BeachlineItemType::Arc)
+    {
+        // NOTE: The edge separating the rightmost arc of the left subtree from the leftmost arc of
+        //       the right subtree is always the current item itself.
+        assert(GetFirstParentOnTheRight(beachline, GetFirstLeafOnTheLeft(beachline, currentItem)) == currentItem);
+        assert(GetFirstParentOnTheLeft(beachline, GetFirstLeafOnTheRight(beachline, currentItem)) == currentItem);
+        if((double)x < GetEdgeBreakpointXCoord(beachline, currentItem, directrixY))
         {
-            currentItem = currentItem->left;
+            currentItem = beachline.left[currentItem];
         }
         else
         {
-            currentItem = currentItem->right;
+            currentItem = beachline.right[currentItem];
         }
     }
 
-    assert(currentItem->type == BeachlineItemType::Arc);
+    assert(beachline.type[currentItem] == BeachlineItemType::Arc);
     return currentItem;
 }
 
-static BeachlineItem* CreateArc(Vector2 focus)
+uint32_t GetActiveArcForXCoord(const Beachline& beachline, float x, float directrixY)
+{
+    return GetActiveArcInSubtree(beachline, beachline.root, x, directrixY);
+}
+
+// NOTE: Finger search: finds the same arc as GetActiveArcForXCoord, but starting from an arc that
+//       is expected to be nearby. The edges that bound the subtrees containing the finger on one
+//       side are exactly the edges that we pass going up from the finger while coming from the
+//       other side, and their breakpoints move steadily further away from the finger. So we walk up
+//       through them until we reach one that is beyond x, and x must then be within the subtree
+//       just inside the previous one. That takes time proportional to how far away along the
+//       beachline the arc is (in a balanced tree), rather than to the depth of the whole tree.
+//       Gives up and starts from the root after MaxFingerSearchSteps edges, or if the finger is no
+//       longer an arc.
+const uint32_t MaxFingerSearchSteps = 16;
+static uint32_t GetActiveArcFromFinger(const Beachline& beachline, uint32_t finger, float x, float directrixY)
+{
+    if((finger == InvalidIndex) || (beachline.type[finger] != BeachlineItemType::Arc))
+    {
+        return GetActiveArcForXCoord(beachline, x, directrixY);
+    }
+
+    uint32_t boundary = GetFirstParentOnTheLeft(beachline, finger);
+    if((boundary != InvalidIndex) && ((double)x < GetEdgeBreakpointXCoord(beachline, boundary, directrixY)))
+    {
+        for(uint32_t step=0; step<MaxFingerSearchSteps; step++)
+        {
+            uint32_t next = GetFirstParentOnTheLeft(beachline, boundary);
+            if((next == InvalidIndex) || ((double)x >= GetEdgeBreakpointXCoord(beachline, next, directrixY)))
+            {
+                return GetActiveArcInSubtree(beachline, beachline.left[boundary], x, directrixY);
+            }
+            boundary = next;
+        }
+        return GetActiveArcForXCoord(beachline, x, directrixY);
+    }
+
+    boundary = GetFirstParentOnTheRight(beachline, finger);
+    if((boundary != InvalidIndex) && ((double)x >= GetEdgeBreakpointXCoord(beachline, boundary, directrixY)))
+    {
+        for(uint32_t step=0; step<MaxFingerSearchSteps; step++)
+        {
+            uint32_t next = GetFirstParentOnTheRight(beachline, boundary);
+            if((next == InvalidIndex) || ((double)x < GetEdgeBreakpointXCoord(beachline, next, directrixY)))
+            {
+                return GetActiveArcInSubtree(beachline, beachline.right[boundary], x, directrixY);
+            }
+            boundary = next;
+        }
+        return GetActiveArcForXCoord(beachline, x, directrixY);
+    }
+    return finger;
+}
+
+static uint32_t CreateArc(Beachline& beachline, Vector2 focus, uint32_t site)
 {
-    BeachlineItem* result = new BeachlineItem();
-    result->type = BeachlineItemType::Arc;
-    result->arc.focus = focus;
-    result->arc.squeezeEvent = nullptr;
+    uint32_t result = AllocateBeachlineItem(beachline, BeachlineItemType::Arc);
+    beachline.point[result] = focus;
+    beachline.site[result] = site;
     return result;
 }
-static BeachlineItem* CreateEdge(Vector2 start, Vector2 dir)
+static uint32_t CreateEdge(Beachline& beachline, Vector2 start, Vector2 dir)
 {
-    BeachlineItem* result = new BeachlineItem();
-    result->type = BeachlineItemType::Edge;
-    result->edge.start = start;
-    result->edge.direction = dir;
-    result->edge.extendsUpwardsForever = false;
+    uint32_t result = AllocateBeachlineItem(beachline, BeachlineItemType::Edge);
+    beachline.point[result] = start;
+    beachline.direction[result] = dir;
     return result;
 }
 
-bool TryGetEdgeIntersectionPoint(Edge& e1, Edge& e2, Vector2& intersectionPt)
+static uint32_t PushEvent(FortuneContext& context, const SweepEvent& evt)
+{
+    uint32_t eventIndex;
+    if(!context.freeEvents.empty())
+    {
+        eventIndex = context.freeEvents.back();
+        context.freeEvents.pop_back();
+        context.events[eventIndex] = evt;
+    }
+    else
+    {
+        eventIndex = (uint32_t)context.events.size();
+        context.events.emplace_back(evt);
+    }
+
+    context.eventQueue.emplace_back(eventIndex);
+    std::push_heap(context.eventQueue.begin(), context.eventQueue.end(), EventComparison{context.events.data()});
+    return eventIndex;
+}
+
+static uint32_t PeekEvent(const FortuneContext& context)
 {
-    float dx = e2.start.x - e1.start.x;
-    float dy = e2.start.y - e1.start.y;
-    float det = e2.direction.x*e1.direction.y - e2.direction.y*e1.direction.x;
-    float u = (dy*e2.direction.x - dx*e2.direction.y)/det;
-    float v = (dy*e1.direction.x - dx*e1.direction.y)/det;
+    assert(!context.eventQueue.empty());
+    return context.eventQueue.front();
+}
 
-    if((u < 0.0f) && !e1.extendsUpwardsForever) return false;
-    if((v < 0.0f) && !e2.extendsUpwardsForever) return false;
-    if((u == 0.0f) && (v == 0.0f) && !e1.extendsUpwardsForever && !e2.extendsUpwardsForever) return false;
+static uint32_t PopEvent(FortuneContext& context)
+{
+    assert(!context.eventQueue.empty());
+    std::pop_heap(context.eventQueue.begin(), context.eventQueue.end(), EventComparison{context.events.data()});
+    uint32_t result = context.eventQueue.back();
+    context.eventQueue.pop_back();
+    return result;
+}
 
-    intersectionPt = {e1.start.x + e1.direction.x*u, e1.start.y + e1.direction.y*u};
-    return true;
+static void FreeEvent(FortuneContext& context, uint32_t eventIndex)
+{
+    context.freeEvents.emplace_back(eventIndex);
 }
 
-void AddArcSqueezeEvent(
-        std::priority_queue<SweepEvent*, std::vector<SweepEvent*>, EventComparison>& eventQueue,
-        BeachlineItem* arc)
+// NOTE: Beachline edges always point along the clockwise perpendicular of the offset from their
+//       left arc's focus to their right arc's focus, so when walking along an edge its beachline-left
+//       arc is on the right-hand side and vice versa. Output edges are oriented so that the edge
+//       which traces out vertexB walks from A to B.
+static void StartOutputEdge(FortuneState& state, uint32_t beachlineEdge, uint32_t leftArcSite, uint32_t rightArcSite, uint32_t vertexA)
 {
-    BeachlineItem* leftEdge = GetFirstParentOnTheLeft(arc);
-    BeachlineItem* rightEdge = GetFirstParentOnTheRight(arc);
+    Beachline& beachline = state.beachline;
+    CompleteEdge edge;
+    edge.vertexA = vertexA;
+    edge.vertexB = InvalidIndex;
+    edge.leftSite = rightArcSite;
+    edge.rightSite = leftArcSite;
+
+    beachline.outputEdge[beachlineEdge] = (uint32_t)state.edges.size();
+    beachline.finishesAtVertexA[beachlineEdge] = false;
+    state.edges.emplace_back(edge);
+}
+
+static void StartOutputEdge(FortuneState& state, uint32_t beachlineEdge, uint32_t vertexA)
+{
+    const Beachline& beachline = state.beachline;
+    uint32_t leftArc = GetFirstLeafOnTheLeft(beachline, beachlineEdge);
+    uint32_t rightArc = GetFirstLeafOnTheRight(beachline, beachlineEdge);
+    StartOutputEdge(state, beachlineEdge, beachline.site[leftArc], beachline.site[rightArc], vertexA);
+}
 
-    if((leftEdge == nullptr) || (rightEdge == nullptr))
+static void FinishOutputEdge(FortuneState& state, uint32_t beachlineEdge, uint32_t vertex)
+{
+    const Beachline& beachline = state.beachline;
+    CompleteEdge& edge = state.edges[beachline.outputEdge[beachlineEdge]];
+    if(beachline.finishesAtVertexA[beachlineEdge])
     {
-        return;
+        assert(edge.vertexA == InvalidIndex);
+        edge.vertexA = vertex;
+    }
+    else
+    {
+        assert(edge.vertexB == InvalidIndex);
+        edge.vertexB = vertex;
     }
+}
 
-    Vector2 circleEventPoint;
-    bool edgesIntersect = TryGetEdgeIntersectionPoint(leftEdge->edge, rightEdge->edge, circleEventPoint);
-    if(!edgesIntersect)
+// NOTE: Adds the event for when the given arc gets squeezed out of the beachline by its neighbours.
+//       Any event that the arc already had was for a different pair of neighbours, so it is always
+//       replaced. The event comes straight from the circle through the three arcs' foci, computed
+//       relative to the middle focus so that the terms stay small and nothing depends on the edges'
+//       start points. The arc only gets squeezed out if the two outer foci turn clockwise around the
+//       middle one (walking left to right along the beachline), which is the same sign test that
+//       makes the denominator positive.
+void AddArcSqueezeEvent(FortuneContext& context, uint32_t arc)
+{
+    Beachline& beachline = context.state.beachline;
+    assert(beachline.type[arc] == BeachlineItemType::Arc);
+    uint32_t existingEvent = beachline.squeezeEvent[arc];
+    if(existingEvent != InvalidIndex)
+    {
+        assert(context.events[existingEvent].type == SweepEventType::EdgeIntersection);
+        context.events[existingEvent].edgeIntersect.isValid = false;
+        beachline.squeezeEvent[arc] = InvalidIndex;
+    }
+
+    uint32_t leftEdge = GetFirstParentOnTheLeft(beachline, arc);
+    uint32_t rightEdge = GetFirstParentOnTheRight(beachline, arc);
+    if((leftEdge == InvalidIndex) || (rightEdge == InvalidIndex))
     {
         return;
     }
 
-    Vector2 circleCentreOffset = {arc->arc.focus.x - circleEventPoint.x,
-                                  arc->arc.focus.y - circleEventPoint.y};
-    float circleRadius = Magnitude(circleCentreOffset);
-    float circleEventY = circleEventPoint.y - circleRadius;
-    assert(arc->type == BeachlineItemType::Arc);
-    // NOTE: If we already have an intersection event that we'll encounter sooner than this one, then
-    //       just don't add this one (because otherwise it'll reference a deleted arc when it gets processed)
-    if(arc->arc.squeezeEvent != nullptr)
+    Vector2 focus = beachline.point[arc];
+    Vector2 leftFocus = beachline.point[GetFirstLeafOnTheLeft(beachline, leftEdge)];
+    Vector2 rightFocus = beachline.point[GetFirstLeafOnTheRight(beachline, rightEdge)];
+    double leftX = (double)leftFocus.x - (double)focus.x;
+    double leftY = (double)leftFocus.y - (double)focus.y;
+    double rightX = (double)rightFocus.x - (double)focus.x;
+    double rightY = (double)rightFocus.y - (double)focus.y;
+    double denominator = 2.0*(leftX*rightY - leftY*rightX);
+    if(!(denominator > 0.0))
     {
-        if(arc->arc.squeezeEvent->yCoord >= circleEventY)
-        {
-            return;
-        }
-        else
-        {
-            assert(arc->arc.squeezeEvent->type == SweepEventType::EdgeIntersection);
-            arc->arc.squeezeEvent->edgeIntersect.isValid = false;
-        }
+        return;
     }
-    //printf("Add circle event at y=%f\n", circleEventY);
-    SweepEvent* newEvt = new SweepEvent();
-    newEvt->type = SweepEventType::EdgeIntersection;
-    newEvt->yCoord = circleEventY;
-    newEvt->edgeIntersect.squeezedArc = arc;
-    newEvt->edgeIntersect.intersectionPoint = circleEventPoint;
-    newEvt->edgeIntersect.isValid = true;
-    eventQueue.push(newEvt);
 
-    arc->arc.squeezeEvent = newEvt;
+    // NOTE: Nearly-collinear foci give a huge circle whose centre is far above the foci, and then
+    //       the bottom of the circle is the difference of two huge numbers. In that case we use
+    //       offset.y - |offset| = -offset.x^2/(offset.y + |offset|) instead, which has no cancellation.
+    double leftLengthSq = leftX*leftX + leftY*leftY;
+    double rightLengthSq = rightX*rightX + rightY*rightY;
+    double centreOffsetX = (rightY*leftLengthSq - leftY*rightLengthSq)/denominator;
+    double centreOffsetY = (leftX*rightLengthSq - rightX*leftLengthSq)/denominator;
+    double radius = sqrt(centreOffsetX*centreOffsetX + centreOffsetY*centreOffsetY);
+    double bottomOffsetY = (centreOffsetY > 0.0) ? (-centreOffsetX*centreOffsetX/(centreOffsetY + radius))
+                                                 : (centreOffsetY - radius);
+    Vector2 circleEventPoint = {(float)((double)focus.x + centreOffsetX), (float)((double)focus.y + centreOffsetY)};
+    float circleEventY = (float)((double)focus.y + bottomOffsetY);
+    //printf("Add circle event at y=%f\n", circleEventY);
+    SweepEvent newEvt;
+    newEvt.type = SweepEventType::EdgeIntersection;
+    newEvt.yCoord = circleEventY;
+    newEvt.edgeIntersect.squeezedArc = arc;
+    newEvt.edgeIntersect.intersectionPoint = circleEventPoint;
+    newEvt.edgeIntersect.isValid = true;
+    beachline.squeezeEvent[arc] = PushEvent(context, newEvt);
 }
 
-BeachlineItem* AddArcToBeachline(std::priority_queue<SweepEvent*, std::vector<SweepEvent*>, EventComparison>& eventQueue,
-                       BeachlineItem* root, SweepEvent& evt, float sweepLineY)
+void AddArcToBeachline(FortuneContext& context, uint32_t newSite, float sweepLineY)
 {
-    //printf("Add arc @ (%f, %f) to the beachline\n", evt.newPoint.point.x, evt.newPoint.point.y);
-    Vector2 newPoint = evt.newPoint.point;
-    BeachlineItem* replacedArc = GetActiveArcForXCoord(root, newPoint.x, sweepLineY);
-    assert((replacedArc != nullptr) && (replacedArc->type == BeachlineItemType::Arc));
-
-    BeachlineItem* splitArcLeft = CreateArc(replacedArc->arc.focus);
-    BeachlineItem* splitArcRight = CreateArc(replacedArc->arc.focus);
-    BeachlineItem* newArc = CreateArc(newPoint);
-
-    float intersectionY = GetArcYForXCoord(replacedArc->arc, newPoint.x, sweepLineY);
+    Vector2 newPoint = context.state.sites[newSite];
+    //printf("Add arc @ (%f, %f) to the beachline\n", newPoint.x, newPoint.y);
+    Beachline& beachline = context.state.beachline;
+    BeginSweepPerfPhase(context.perfCounters, SweepPerfPhase::PointLocation);
+    uint32_t replacedArc = GetActiveArcFromFinger(beachline, context.fingerArc, newPoint.x, sweepLineY);
+    EndSweepPerfPhase(context.perfCounters, SweepPerfPhase::PointLocation);
+    assert((replacedArc != InvalidIndex) && (beachline.type[replacedArc] == BeachlineItemType::Arc));
+    Vector2 replacedFocus = beachline.point[replacedArc];
+    uint32_t replacedSite = beachline.site[replacedArc];
+
+    uint32_t splitArcLeft = CreateArc(beachline, replacedFocus, replacedSite);
+    uint32_t splitArcRight = CreateArc(beachline, replacedFocus, replacedSite);
+    uint32_t newArc = CreateArc(beachline, newPoint, newSite);
+    context.fingerArc = newArc;
+
+    float intersectionY = GetArcYForXCoord(replacedFocus, newPoint.x, sweepLineY);
     assert(isfinite(intersectionY));
     Vector2 edgeStart = {newPoint.x, intersectionY};
-    Vector2 focusOffset = {newArc->arc.focus.x - replacedArc->arc.focus.x,
-                           newArc->arc.focus.y - replacedArc->arc.focus.y};
+    Vector2 focusOffset = {newPoint.x - replacedFocus.x,
+                           newPoint.y - replacedFocus.y};
     Vector2 edgeDir = normalize({focusOffset.y, -focusOffset.x});
-    BeachlineItem* edgeLeft = CreateEdge(edgeStart, edgeDir);
-    BeachlineItem* edgeRight = CreateEdge(edgeStart, {-edgeDir.x, -edgeDir.y});
-
-    assert(replacedArc->left == nullptr);
-    assert(replacedArc->right == nullptr);
-    edgeLeft->SetParentFromItem(replacedArc);
-    edgeLeft->SetLeft(splitArcLeft);
-    edgeLeft->SetRight(edgeRight);
-    edgeRight->SetLeft(newArc);
-    edgeRight->SetRight(splitArcRight);
-
-    BeachlineItem* newRoot = root;
-    if(root == replacedArc)
+    uint32_t edgeLeft = CreateEdge(beachline, edgeStart, edgeDir);
+    uint32_t edgeRight = CreateEdge(beachline, edgeStart, {-edgeDir.x, -edgeDir.y});
+
+    assert(beachline.left[replacedArc] == InvalidIndex);
+    assert(beachline.right[replacedArc] == InvalidIndex);
+    SetBeachlineParentFromItem(beachline, edgeLeft, replacedArc);
+    SetBeachlineLeft(beachline, edgeLeft, splitArcLeft);
+    SetBeachlineRight(beachline, edgeLeft, edgeRight);
+    SetBeachlineLeft(beachline, edgeRight, newArc);
+    SetBeachlineRight(beachline, edgeRight, splitArcRight);
+
+    if(beachline.root == replacedArc)
     {
-        newRoot = edgeLeft;
+        beachline.root = edgeLeft;
     }
-    if(replacedArc->arc.squeezeEvent != nullptr)
+
+    // NOTE: The two new beachline edges trace out the same Voronoi edge in opposite directions,
+    //       starting from a point that is not a vertex, so they share a single output edge.
+    StartOutputEdge(context.state, edgeLeft, InvalidIndex);
+    beachline.outputEdge[edgeRight] = beachline.outputEdge[edgeLeft];
+    beachline.finishesAtVertexA[edgeRight] = true;
+
+    uint32_t replacedSqueezeEvent = beachline.squeezeEvent[replacedArc];
+    if(replacedSqueezeEvent != InvalidIndex)
     {
-        assert(replacedArc->arc.squeezeEvent->type == SweepEventType::EdgeIntersection);
-        assert(replacedArc->arc.squeezeEvent->edgeIntersect.isValid);
-        replacedArc->arc.squeezeEvent->edgeIntersect.isValid = false;
+        SweepEvent& squeezeEvent = context.events[replacedSqueezeEvent];
+        assert(squeezeEvent.type == SweepEventType::EdgeIntersection);
+        assert(squeezeEvent.edgeIntersect.isValid);
+        squeezeEvent.edgeIntersect.isValid = false;
     }
-    VerifyThatThereAreNoReferencesToItem(newRoot, replacedArc);
-    assert((replacedArc->arc.squeezeEvent == nullptr) || (replacedArc->arc.squeezeEvent->edgeIntersect.isValid == false));
-    delete replacedArc;
-
-    AddArcSqueezeEvent(eventQueue, splitArcLeft);
-    AddArcSqueezeEvent(eventQueue, splitArcRight);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.root, replacedArc);
+    FreeBeachlineItem(beachline, replacedArc);
 
-    return newRoot;
+    AddArcSqueezeEvent(context, splitArcLeft);
+    AddArcSqueezeEvent(context, splitArcRight);
 }
 
-BeachlineItem* RemoveArcFromBeachline(
-        std::priority_queue<SweepEvent*, std::vector<SweepEvent*>, EventComparison>& eventQueue,
-        BeachlineItem* root,
-        std::vector<CompleteEdge*>& outputEdges,
-        SweepEvent& evt)
+void RemoveArcFromBeachline(FortuneContext& context, uint32_t eventIndex)
 {
-    BeachlineItem* squeezedArc = evt.edgeIntersect.squeezedArc;
+    Beachline& beachline = context.state.beachline;
+    const SweepEvent& evt = context.events[eventIndex];
+    uint32_t squeezedArc = evt.edgeIntersect.squeezedArc;
     assert(evt.type == SweepEventType::EdgeIntersection);
     assert(evt.edgeIntersect.isValid);
-    assert(squeezedArc->arc.squeezeEvent == &evt);
-    //printf("Remove arc @ (%f, %f) from the beachline because we reached y=%f\n", squeezedArc->arc.focus.x, squeezedArc->arc.focus.y, evt.yCoord);
+    assert(beachline.squeezeEvent[squeezedArc] == eventIndex);
+    //printf("Remove arc @ (%f, %f) from the beachline because we reached y=%f\n", beachline.point[squeezedArc].x, beachline.point[squeezedArc].y, evt.yCoord);
 
-    BeachlineItem* leftEdge = GetFirstParentOnTheLeft(squeezedArc);
-    BeachlineItem* rightEdge = GetFirstParentOnTheRight(squeezedArc);
-    assert((leftEdge != nullptr) && (rightEdge != nullptr));
+    uint32_t leftEdge = GetFirstParentOnTheLeft(beachline, squeezedArc);
+    uint32_t rightEdge = GetFirstParentOnTheRight(beachline, squeezedArc);
+    assert((leftEdge != InvalidIndex) && (rightEdge != InvalidIndex));
 
-    BeachlineItem* leftArc = GetFirstLeafOnTheLeft(leftEdge);
-    BeachlineItem* rightArc = GetFirstLeafOnTheRight(rightEdge);
-    assert((leftArc != nullptr) && (rightArc != nullptr));
+    uint32_t leftArc = GetFirstLeafOnTheLeft(beachline, leftEdge);
+    uint32_t rightArc = GetFirstLeafOnTheRight(beachline, rightEdge);
+    assert((leftArc != InvalidIndex) && (rightArc != InvalidIndex));
     assert(leftArc != rightArc);
 
     Vector2 circleCentre = evt.edgeIntersect.intersectionPoint;
-    CompleteEdge* edgeA = new CompleteEdge();
-    edgeA->endpointA = leftEdge->edge.start;
-    edgeA->endpointB = circleCentre;
-    CompleteEdge* edgeB = new CompleteEdge();
-    edgeB->endpointA = circleCentre;
-    edgeB->endpointB = rightEdge->edge.start;
-
-    if(leftEdge->edge.extendsUpwardsForever)
-    {
-        edgeA->endpointA.y = FLT_MAX;
-    }
-    if(rightEdge->edge.extendsUpwardsForever)
-    {
-        edgeB->endpointA.y = FLT_MAX;
-    }
-    outputEdges.emplace_back(edgeA);
-    outputEdges.emplace_back(edgeB);
+    uint32_t circleVertex = (uint32_t)context.state.vertices.size();
+    context.state.vertices.emplace_back(circleCentre);
+    FinishOutputEdge(context.state, leftEdge, circleVertex);
+    FinishOutputEdge(context.state, rightEdge, circleVertex);
 
     Vector2 adjacentArcOffset = {};
-    adjacentArcOffset.x = rightArc->arc.focus.x - leftArc->arc.focus.x;
-    adjacentArcOffset.y = rightArc->arc.focus.y - leftArc->arc.focus.y;
+    adjacentArcOffset.x = beachline.point[rightArc].x - beachline.point[leftArc].x;
+    adjacentArcOffset.y = beachline.point[rightArc].y - beachline.point[leftArc].y;
     Vector2 newEdgeDirection = {adjacentArcOffset.y, -adjacentArcOffset.x};
     newEdgeDirection = normalize(newEdgeDirection);
 
-    BeachlineItem* newItem = CreateEdge(circleCentre, newEdgeDirection);
+    uint32_t newItem = CreateEdge(beachline, circleCentre, newEdgeDirection);
 
-    BeachlineItem* higherEdge = nullptr;
-    BeachlineItem* tempItem = squeezedArc;
-    while(tempItem->parent != nullptr)
+    uint32_t higherEdge = InvalidIndex;
+    uint32_t tempItem = squeezedArc;
+    while(beachline.parent[tempItem] != InvalidIndex)
     {
-        tempItem = tempItem->parent;
+        tempItem = beachline.parent[tempItem];
         if(tempItem == leftEdge) higherEdge = leftEdge;
         if(tempItem == rightEdge) higherEdge = rightEdge;
     }
-    assert((higherEdge != nullptr) && (higherEdge->type == BeachlineItemType::Edge));
+    assert((higherEdge != InvalidIndex) && (beachline.type[higherEdge] == BeachlineItemType::Edge));
 
-    newItem->SetParentFromItem(higherEdge);
-    newItem->SetLeft(higherEdge->left);
-    newItem->SetRight(higherEdge->right);
+    SetBeachlineParentFromItem(beachline, newItem, higherEdge);
+    SetBeachlineLeft(beachline, newItem, beachline.left[higherEdge]);
+    SetBeachlineRight(beachline, newItem, beachline.right[higherEdge]);
 
-    assert((squeezedArc->parent == nullptr) || (squeezedArc->parent->type == BeachlineItemType::Edge));
-    BeachlineItem* remainingItem = nullptr;
-    BeachlineItem* parent = squeezedArc->parent;
-    if(parent->left == squeezedArc)
+    uint32_t parent = beachline.parent[squeezedArc];
+    assert((parent != InvalidIndex) && (beachline.type[parent] == BeachlineItemType::Edge));
+    uint32_t remainingItem = InvalidIndex;
+    if(beachline.left[parent] == squeezedArc)
     {
-        remainingItem = parent->right;
+        remainingItem = beachline.right[parent];
     }
     else
     {
-        assert(parent->right == squeezedArc);
-        remainingItem = parent->left;
+        assert(beachline.right[parent] == squeezedArc);
+        remainingItem = beachline.left[parent];
     }
     assert((parent == leftEdge) || (parent == rightEdge));
     assert(parent != higherEdge);
 
-    remainingItem->SetParentFromItem(parent);
+    SetBeachlineParentFromItem(beachline, remainingItem, parent);
 
-    BeachlineItem* newRoot = root;
-    if((root == leftEdge) || (root == rightEdge))
+    if((beachline.root == leftEdge) || (beachline.root == rightEdge))
     {
-        newRoot = newItem;
+        beachline.root = newItem;
     }
-    VerifyThatThereAreNoReferencesToItem(newRoot, leftEdge);
-    VerifyThatThereAreNoReferencesToItem(newRoot, squeezedArc);
-    VerifyThatThereAreNoReferencesToItem(newRoot, rightEdge);
-    assert(squeezedArc->type == BeachlineItemType::Arc);
-    if(squeezedArc->arc.squeezeEvent != nullptr)
+    StartOutputEdge(context.state, newItem, circleVertex);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.root, leftEdge);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.root, squeezedArc);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.root, rightEdge);
+    assert(beachline.type[squeezedArc] == BeachlineItemType::Arc);
+    context.events[eventIndex].edgeIntersect.isValid = false;
+    FreeBeachlineItem(beachline, leftEdge);
+    FreeBeachlineItem(beachline, squeezedArc);
+    FreeBeachlineItem(beachline, rightEdge);
+
+    AddArcSqueezeEvent(context, leftArc);
+    AddArcSqueezeEvent(context, rightArc);
+}
+
+// NOTE: Pre-sizes all of the context's buffers for a diagram of the given number of sites.
+//       By Euler's formula a diagram of n sites has at most 2n-5 vertices (each of which is one
+//       circle event) and at most 3n-6 edges. Every beachline item is created either by a site
+//       event (at most 5 per site: 3 arcs and 2 edges) or by a circle event (one edge).
+void ReserveFortuneContext(FortuneContext& context, size_t siteCount)
+{
+    size_t maxVertexCount = (siteCount > 2) ? (2*siteCount - 5) : 0;
+    size_t maxBeachlineItemCount = 2*siteCount + 2*siteCount;
+    size_t maxOutputEdgeCount = 3*siteCount;
+    size_t maxEventCount = 2*siteCount + 2*maxVertexCount;
+
+    context.state.sites.reserve(siteCount);
+    context.state.canonicalSite.reserve(siteCount);
+    context.siteHashTable.reserve(4*siteCount);
+    context.siteOrder.reserve(siteCount);
+
+    Beachline& beachline = context.state.beachline;
+    beachline.type.reserve(maxBeachlineItemCount);
+    beachline.point.reserve(maxBeachlineItemCount);
+    beachline.direction.reserve(maxBeachlineItemCount);
+    beachline.parent.reserve(maxBeachlineItemCount);
+    beachline.left.reserve(maxBeachlineItemCount);
+    beachline.right.reserve(maxBeachlineItemCount);
+    beachline.squeezeEvent.reserve(maxBeachlineItemCount);
+    beachline.site.reserve(maxBeachlineItemCount);
+    beachline.outputEdge.reserve(maxBeachlineItemCount);
+    beachline.finishesAtVertexA.reserve(maxBeachlineItemCount);
+    beachline.freeItems.reserve(maxBeachlineItemCount);
+
+    context.state.vertices.reserve(maxVertexCount);
+    context.state.edges.reserve(maxOutputEdgeCount);
+    context.state.unencounteredEvents.reserve(maxEventCount);
+    context.events.reserve(maxEventCount);
+    context.freeEvents.reserve(maxEventCount);
+    context.eventQueue.reserve(maxEventCount);
+    if(siteCount < context.smallDiagramSiteCount)
     {
-        assert(squeezedArc->arc.squeezeEvent->type == SweepEventType::EdgeIntersection);
-        assert(squeezedArc->arc.squeezeEvent->edgeIntersect.isValid);
-        squeezedArc->arc.squeezeEvent->edgeIntersect.isValid = false;
+        context.smallDiagramVertexKeys.reserve(maxVertexCount);
     }
-    delete leftEdge;
-    delete squeezedArc;
-    delete rightEdge;
-
-    AddArcSqueezeEvent(eventQueue, leftArc);
-    AddArcSqueezeEvent(eventQueue, rightArc);
-    return newRoot;
 }
 
-void FinishEdge(BeachlineItem* item, std::vector<CompleteEdge*>& edges)
+// NOTE: The number of arcs on the beachline is about the number of cells that the sweep line
+//       crosses, and a line through a region with n sites per unit area crosses about sqrt(n) cells
+//       per unit length. So with the sites binned into square buckets, a sweep line along a row of
+//       buckets crosses about the sum of the square roots of their counts, and every site event
+//       pays for the beachline at its own row. We compare that total for rows (sweeping in y)
+//       against the same for columns (sweeping in x), which accounts for gaps and clusters as well
+//       as the overall extent of the sites.
+static void ChooseSweepAxis(FortuneContext& context)
 {
-    if(item == nullptr)
+    const uint32_t MaxHistogramSize = 64;
+    const std::vector<Vector2>& sites = context.state.sites;
+    context.isSweepAlongX = false;
+    if(!context.chooseSweepAxis || (sites.size() < std::max(context.smallDiagramSiteCount, 2u)))
     {
         return;
     }
 
-    if (item->type == BeachlineItemType::Edge)
+    Vector2 minCorner = {FLT_MAX, FLT_MAX};
+    Vector2 maxCorner = {-FLT_MAX, -FLT_MAX};
+    for(Vector2 site : sites)
+    {
+        minCorner = {min(minCorner.x, site.x), min(minCorner.y, site.y)};
+        maxCorner = {max(maxCorner.x, site.x), max(maxCorner.y, site.y)};
+    }
+    float width = maxCorner.x - minCorner.x;
+    float height = maxCorner.y - minCorner.y;
+    float bucketScale = (float)MaxHistogramSize/max(width, height);
+    if(!(bucketScale < FLT_MAX))
+    {
+        return;
+    }
+    uint32_t histogramWidth = std::min(MaxHistogramSize, 1 + (uint32_t)(width*bucketScale));
+    uint32_t histogramHeight = std::min(MaxHistogramSize, 1 + (uint32_t)(height*bucketScale));
+
+    std::vector<uint32_t>& histogram = context.sweepAxisHistogram;
+    histogram.assign(histogramWidth*histogramHeight + histogramWidth + histogramHeight, 0);
+    uint32_t* columnCount = histogram.data() + histogramWidth*histogramHeight;
+    uint32_t* rowCount = columnCount + histogramWidth;
+    for(Vector2 site : sites)
     {
-        float length = 10000;
-        Vector2 edgeEnd = item->edge.start;
-        edgeEnd.x += length * item->edge.direction.x;
-        edgeEnd.y += length * item->edge.direction.y;
+        uint32_t column = std::min(histogramWidth - 1, (uint32_t)((site.x - minCorner.x)*bucketScale));
+        uint32_t row = std::min(histogramHeight - 1, (uint32_t)((site.y - minCorner.y)*bucketScale));
+        histogram[row*histogramWidth + column]++;
+        columnCount[column]++;
+        rowCount[row]++;
+    }
 
-        CompleteEdge* edge = new CompleteEdge();
-        edge->endpointA = item->edge.start;
-        edge->endpointB = edgeEnd;
-        edges.emplace_back(edge);
+    double sweepCostY = 0.0;
+    double sweepCostX = 0.0;
+    for(uint32_t row=0; row<histogramHeight; row++)
+    {
+        for(uint32_t column=0; column<histogramWidth; column++)
+        {
+            double crossings = sqrt((double)histogram[row*histogramWidth + column]);
+            sweepCostY += (double)rowCount[row]*crossings;
+            sweepCostX += (double)columnCount[column]*crossings;
+        }
+    }
+    context.isSweepAlongX = (sweepCostX < sweepCostY);
+}
 
-        FinishEdge(item->left, edges);
-        FinishEdge(item->right, edges);
+// NOTE: A sweep along x is a sweep along y of the sites rotated a quarter turn clockwise, taking
+//       (x,y) to (y,-x). That is exact in floating point, and a rotation (unlike swapping x and y)
+//       keeps the left and right sides of every edge the same, so the output can be rotated back
+//       without touching the edges.
+static void RotateIntoSweepFrame(std::vector<Vector2>& points)
+{
+    for(Vector2& point : points)
+    {
+        point = {point.y, -point.x};
     }
+}
 
-    delete item;
+static void RotateOutOfSweepFrame(std::vector<Vector2>& points)
+{
+    for(Vector2& point : points)
+    {
+        point = {-point.y, point.x};
+    }
 }
 
-FortuneState FortunesAlgorithm(std::vector<Vector2>& sites, float cutoffY)
+static void SortFortuneSites(FortuneContext& context)
 {
-    std::vector<CompleteEdge*> edges;
-    std::priority_queue<SweepEvent*, std::vector<SweepEvent*>, EventComparison> eventQueue;
-    for(Vector2 pt : sites)
+    FortuneState& state = context.state;
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    context.siteOrder.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        context.siteOrder[i] = i;
+    }
+    // NOTE: Prepared sites are kept the right way round, and only rotated while the sweep runs.
+    //       Descending y' = -x is ascending x, and ascending x' = y is ascending y.
+    const Vector2* sitePositions = state.sites.data();
+    if(context.isSweepAlongX)
     {
-        SweepEvent* evt = new SweepEvent();
-        evt->type = SweepEventType::NewPoint;
-        evt->newPoint.point = pt;
-        evt->yCoord = pt.y;
-        eventQueue.push(evt);
+        std::sort(context.siteOrder.begin(), context.siteOrder.end(), [sitePositions](uint32_t lhs, uint32_t rhs)
+        {
+            Vector2 l = sitePositions[lhs];
+            Vector2 r = sitePositions[rhs];
+            if(l.x != r.x) return l.x < r.x;
+            return l.y < r.y;
+        });
+        return;
     }
+    std::sort(context.siteOrder.begin(), context.siteOrder.end(), [sitePositions](uint32_t lhs, uint32_t rhs)
+    {
+        Vector2 l = sitePositions[lhs];
+        Vector2 r = sitePositions[rhs];
+        if(l.y != r.y) return l.y > r.y;
+        return l.x < r.x;
+    });
+}
 
-    // NOTE: We start out by taking the first event and handling it manually, because it lets
-    //       us avoid the "is there an arc here" check that would otherwise need to run very often
-    SweepEvent* firstEvent = eventQueue.top();
-    assert(firstEvent->type == SweepEventType::NewPoint);
+static bool IsCancelRequested(const FortuneContext& context)
+{
+    return (context.control != nullptr) && context.control->isCancelRequested.load(std::memory_order_relaxed);
+}
 
-    if(firstEvent->yCoord < cutoffY)
+// NOTE: Everything after merging duplicates, which is the same whether or not that was in place
+static void FinishPreparingFortuneSites(FortuneContext& context, bool isDeduplicated)
+{
+    if(isDeduplicated && !IsCancelRequested(context))
     {
-        FortuneState result = {};
-        result.sweepY = cutoffY;
-        while(!eventQueue.empty())
+        ChooseSweepAxis(context);
+        if(!IsCancelRequested(context))
         {
-            result.unencounteredEvents.emplace_back(eventQueue.top());
-            eventQueue.pop();
+            SortFortuneSites(context);
+            return;
         }
-        return result;
     }
-    eventQueue.pop();
+    context.state.sites.clear();
+    context.state.canonicalSite.clear();
+    context.siteOrder.clear();
+    context.isSweepAlongX = false;
+}
+
+// NOTE: The first stage of computing a diagram: merges duplicate sites and sorts them into the
+//       order in which the sweep will encounter them (top to bottom, then left to right).
+//       This only depends on the sites, so it can run ahead on another thread for the next diagram
+//       while the sweep for the current diagram is still running in a different context.
+void PrepareFortuneSites(FortuneContext& context, const std::vector<Vector2>& sites)
+{
+    TRACE_SCOPE("Prepare sites");
+    ReserveFortuneContext(context, sites.size());
+    FortuneState& state = context.state;
+    const std::atomic<bool>* isCancelRequested = (context.control != nullptr) ? &context.control->isCancelRequested : nullptr;
+    bool isDeduplicated = DeduplicateSites(sites, context.siteMergeEpsilon, state.sites, state.canonicalSite,
+                                           context.siteHashTable, isCancelRequested);
+    FinishPreparingFortuneSites(context, isDeduplicated);
+}
+
+// NOTE: The same as PrepareFortuneSites, for sites that have been written straight into
+//       context.state.sites (e.g. by LoadSiteFile) rather than into a separate list.
+void PrepareFortuneSitesInPlace(FortuneContext& context)
+{
+    TRACE_SCOPE("Prepare sites");
+    FortuneState& state = context.state;
+    ReserveFortuneContext(context, state.sites.size());
+    const std::atomic<bool>* isCancelRequested = (context.control != nullptr) ? &context.control->isCancelRequested : nullptr;
+    bool isDeduplicated = DeduplicateSites(state.sites, context.siteMergeEpsilon, state.sites, state.canonicalSite,
+                                           context.siteHashTable, isCancelRequested);
+    FinishPreparingFortuneSites(context, isDeduplicated);
+}
 
-    BeachlineItem* firstArc = new BeachlineItem();
-    firstArc->type = BeachlineItemType::Arc;
-    firstArc->arc.focus = firstEvent->newPoint.point;
-    firstArc->arc.squeezeEvent = nullptr;
-    delete firstEvent;
-    BeachlineItem* root = firstArc;
+static SweepEvent GetSiteEvent(const FortuneContext& context, uint32_t orderIndex)
+{
+    uint32_t site = context.siteOrder[orderIndex];
+    SweepEvent result;
+    result.type = SweepEventType::NewPoint;
+    result.yCoord = context.state.sites[site].y;
+    result.newPoint.point = context.state.sites[site];
+    result.newPoint.site = site;
+    return result;
+}
 
-    float startupSpecialCaseEndY = firstArc->arc.focus.y - 1.0f;
-    while(!eventQueue.empty() && (eventQueue.top()->yCoord > startupSpecialCaseEndY))
+// NOTE: Builds a balanced beachline for the sites siteOrder[begin] up to (but not including)
+//       siteOrder[end], which must all be at the same height and so are split by vertical edges.
+//       Returns the root of the subtree and outputs its rightmost arc.
+static uint32_t BuildStartupBeachline(FortuneContext& context, uint32_t begin, uint32_t end, uint32_t& rightmostArc)
+{
+    FortuneState& state = context.state;
+    Beachline& beachline = state.beachline;
+    if(end - begin == 1)
     {
-        SweepEvent* evt = eventQueue.top();
-        if(evt->yCoord < cutoffY)
-            break;
-        eventQueue.pop();
+        uint32_t site = context.siteOrder[begin];
+        rightmostArc = CreateArc(beachline, state.sites[site], site);
+        return rightmostArc;
+    }
 
-        assert(evt->type == SweepEventType::NewPoint);
-        Vector2 newFocus = evt->newPoint.point;
-        BeachlineItem* newArc = CreateArc(newFocus);
+    // NOTE: The left half is built before the edge, and the edge before the right half, so that
+    //       output edges come out in order from left to right.
+    uint32_t middle = begin + (end - begin)/2;
+    uint32_t leftArc;
+    uint32_t leftRoot = BuildStartupBeachline(context, begin, middle, leftArc);
+
+    uint32_t rightSite = context.siteOrder[middle];
+    Vector2 leftFocus = beachline.point[leftArc];
+    Vector2 rightFocus = state.sites[rightSite];
+    Vector2 edgeStart = {(leftFocus.x + rightFocus.x)/2.0f, rightFocus.y + 100.0f};
+    Vector2 edgeDir = {0.0f, -1.0f};
+    uint32_t edge = CreateEdge(beachline, edgeStart, edgeDir);
+    StartOutputEdge(state, edge, beachline.site[leftArc], rightSite, InvalidIndex);
+
+    uint32_t rightRoot = BuildStartupBeachline(context, middle, end, rightmostArc);
+    SetBeachlineLeft(beachline, edge, leftRoot);
+    SetBeachlineRight(beachline, edge, rightRoot);
+    return edge;
+}
 
-        BeachlineItem* activeArc = GetActiveArcForXCoord(root, newFocus.x, newFocus.y);
-        assert(activeArc->type == BeachlineItemType::Arc);
+// NOTE: The sweep order refers to sites by index too, so it is remapped along with them in case the
+//       same prepared sites are swept again.
+static void ReorderForLocality(FortuneContext& context)
+{
+    ReorderFortuneState(context.state, context.reordering);
+    for(uint32_t& site : context.siteOrder)
+    {
+        site = context.reordering.newSiteIndex[site];
+    }
+}
+
+// NOTE: The second stage of computing a diagram: runs the sweep over sites that have already been
+//       prepared with PrepareFortuneSites. Site events come straight from the sorted site order and
+//       only circle events go through the event heap, with the two merged as the sweep goes.
+const FortuneState& RunFortuneSweep(FortuneContext& context, float cutoffY)
+{
+    TracePhases sweepPhases;
+    sweepPhases.Begin("Sweep startup");
+    FortuneState& state = context.state;
+    Beachline& beachline = state.beachline;
+    ClearBeachline(beachline);
+    state.vertices.clear();
+    state.edges.clear();
+    state.unencounteredEvents.clear();
+    state.sweepY = 0.0f;
+    context.events.clear();
+    context.freeEvents.clear();
+    context.eventQueue.clear();
+
+    SweepPerfCounters* perfCounters = context.perfCounters;
+    if(perfCounters != nullptr)
+    {
+        ResetSweepPerfCounters(*perfCounters);
+    }
 
-        Vector2 edgeStart = {(newFocus.x+activeArc->arc.focus.x)/2.0f, /*FLT_MAX*//*1000.0f*/newFocus.y+100.0f};
-        Vector2 edgeDir = {0.0f, -1.0f};
-        BeachlineItem* newEdge = CreateEdge(edgeStart, edgeDir);
-        newEdge->edge.extendsUpwardsForever = true;
+    uint32_t siteCount = (uint32_t)context.siteOrder.size();
+    uint32_t nextSite = 0;
 
-        if(activeArc->parent != nullptr)
+    // NOTE: Tiny diagrams are much cheaper to build without the sweep, but that can only produce
+    //       the finished diagram and not the intermediate state of a sweep that has been cut off.
+    //       They count as a sweep with no events.
+    assert(context.smallDiagramSiteCount <= MaxSmallDiagramSiteCount);
+    if((siteCount < context.smallDiagramSiteCount) && (cutoffY == -FLT_MAX))
+    {
+        sweepPhases.Begin("Small diagram");
+        BeginSweepPerfPhase(perfCounters, SweepPerfPhase::Sweep);
+        ComputeSmallDiagram(context);
+        if(context.reorderForLocality)
         {
-            if(activeArc == activeArc->parent->left)
-            {
-                activeArc->parent->SetLeft(newEdge);
-            }
-            else
-            {
-                assert(activeArc == activeArc->parent->right);
-                activeArc->parent->SetRight(newEdge);
-            }
+            ReorderForLocality(context);
         }
-        else
+        EndSweepPerfPhase(perfCounters, SweepPerfPhase::Sweep);
+        return state;
+    }
+
+    // NOTE: A sweep that is cut off is drawn with a horizontal sweep line, so it always runs along y
+    if(context.isSweepAlongX && (cutoffY != -FLT_MAX))
+    {
+        context.isSweepAlongX = false;
+        SortFortuneSites(context);
+    }
+
+    // NOTE: We start out by taking the first event and handling it manually, because it lets
+    //       us avoid the "is there an arc here" check that would otherwise need to run very often
+    if(siteCount == 0)
+    {
+        return state;
+    }
+    if(context.isSweepAlongX)
+    {
+        RotateIntoSweepFrame(state.sites);
+    }
+    SweepEvent firstEvent = GetSiteEvent(context, nextSite);
+    if(firstEvent.yCoord < cutoffY)
+    {
+        state.sweepY = cutoffY;
+        for(; nextSite<siteCount; nextSite++)
         {
-            root = newEdge;
+            state.unencounteredEvents.emplace_back(GetSiteEvent(context, nextSite));
         }
-        if(newFocus.x < activeArc->arc.focus.x)
+        return state;
+    }
+    nextSite++;
+
+    // NOTE: Sites at exactly the same height as the first one would have no arc to land on (every
+    //       arc on the beachline is still a vertical line), so they are split off with vertical edges.
+    //       This must only apply to sites at exactly that height, since any others need real bisectors.
+    //       They are already sorted by x, so the whole row goes straight into a balanced tree.
+    float startupSpecialCaseY = firstEvent.yCoord;
+    uint32_t startupSiteEnd = nextSite;
+    while((startupSiteEnd < siteCount) && (state.sites[context.siteOrder[startupSiteEnd]].y == startupSpecialCaseY))
+    {
+        startupSiteEnd++;
+    }
+    uint32_t rightmostArc;
+    beachline.root = BuildStartupBeachline(context, nextSite - 1, startupSiteEnd, rightmostArc);
+    context.fingerArc = rightmostArc;
+    nextSite = startupSiteEnd;
+
+    sweepPhases.Begin("Sweep main loop");
+    BeginSweepPerfPhase(perfCounters, SweepPerfPhase::Sweep);
+    FortuneSweepControl* control = context.control;
+    float progressTopY = firstEvent.yCoord;
+    float progressRangeY = progressTopY - state.sites[context.siteOrder[siteCount - 1]].y;
+    uint32_t eventsSinceProgress = 0;
+    bool isCancelled = false;
+    while((nextSite < siteCount) || !context.eventQueue.empty())
+    {
+        if(control != nullptr)
         {
-            newEdge->SetLeft(newArc);
-            newEdge->SetRight(activeArc);
+            if(control->isCancelRequested.load(std::memory_order_relaxed))
+            {
+                isCancelled = true;
+                break;
+            }
+            // NOTE: Progress only needs to be roughly up to date, so it is not worth updating every event
+            if(++eventsSinceProgress == 1024)
+            {
+                float sweptY = (nextSite < siteCount) ? (progressTopY - state.sites[context.siteOrder[nextSite]].y) : progressRangeY;
+                float progress = (progressRangeY > 0.0f) ? clampf(sweptY/progressRangeY, 0.0f, 1.0f) : 0.0f;
+                control->progress.store(progress, std::memory_order_relaxed);
+                eventsSinceProgress = 0;
+            }
         }
-        else
+
+        // NOTE: When a site and a circle event are at the same height, the circle event goes first
+        bool isSiteNext = (nextSite < siteCount);
+        float nextY = isSiteNext ? state.sites[context.siteOrder[nextSite]].y : -FLT_MAX;
+        if(!context.eventQueue.empty())
         {
-            newEdge->SetLeft(activeArc);
-            newEdge->SetRight(newArc);
+            float circleY = context.events[PeekEvent(context)].yCoord;
+            if(!isSiteNext || (circleY >= nextY))
+            {
+                isSiteNext = false;
+                nextY = circleY;
+            }
         }
 
-        delete evt;
-    }
-
-    while(!eventQueue.empty())
-    {
-        SweepEvent* nextEvent = eventQueue.top();
         // NOTE: For the purposes of interactive demonstration, we add an artificial cutoff.
-        if(nextEvent->yCoord < cutoffY)
+        if(nextY < cutoffY)
             break;
-        eventQueue.pop();
 
-        float sweepY = nextEvent->yCoord;
-        if(nextEvent->type == SweepEventType::NewPoint)
+        if(isSiteNext)
         {
-            root = AddArcToBeachline(eventQueue, root, *nextEvent, sweepY);
+            BeginSweepPerfPhase(perfCounters, SweepPerfPhase::SiteEvents);
+            AddArcToBeachline(context, context.siteOrder[nextSite], nextY);
+            EndSweepPerfPhase(perfCounters, SweepPerfPhase::SiteEvents);
+            nextSite++;
+            continue;
         }
-        else if(nextEvent->type == SweepEventType::EdgeIntersection)
+
+        uint32_t nextEvent = PopEvent(context);
+        SweepEvent& evt = context.events[nextEvent];
+        if(evt.type == SweepEventType::EdgeIntersection)
         {
-            if(nextEvent->edgeIntersect.isValid)
+            if(evt.edgeIntersect.isValid)
             {
-                root = RemoveArcFromBeachline(eventQueue, root, edges, *nextEvent);
+                BeginSweepPerfPhase(perfCounters, SweepPerfPhase::CircleEvents);
+                RemoveArcFromBeachline(context, nextEvent);
+                EndSweepPerfPhase(perfCounters, SweepPerfPhase::CircleEvents);
             }
         }
         else
         {
-            printf("Unrecognized queue item type: %d\n", nextEvent->type);
+            printf("Unrecognized queue item type: %d\n", (int)evt.type);
+        }
+
+        FreeEvent(context, nextEvent);
+    }
+    sweepPhases.Begin("Sweep cleanup");
+    BeginSweepPerfPhase(perfCounters, SweepPerfPhase::Finalisation);
+    if(isCancelled)
+    {
+        // NOTE: The sites stay prepared (and the right way round), but none of the partial output is kept
+        ClearBeachline(beachline);
+        state.vertices.clear();
+        state.edges.clear();
+        context.events.clear();
+        context.freeEvents.clear();
+        context.eventQueue.clear();
+        if(context.isSweepAlongX)
+        {
+            RotateOutOfSweepFrame(state.sites);
         }
+        EndSweepPerfPhase(perfCounters, SweepPerfPhase::Finalisation);
+        EndSweepPerfPhase(perfCounters, SweepPerfPhase::Sweep);
+        return state;
+    }
+    // NOTE: Any edge still on the beachline at the end never reaches another vertex, so the
+    //       endpoint that it was tracing out is left as an open ray.
+    bool isSweepComplete = (nextSite == siteCount) && context.eventQueue.empty();
+    if(isSweepComplete || (cutoffY < -200.0f))
+    {
+        ClearBeachline(beachline);
+    }
+    if(isSweepComplete && (control != nullptr))
+    {
+        control->progress.store(1.0f, std::memory_order_relaxed);
+    }
+    if(context.isSweepAlongX)
+    {
+        RotateOutOfSweepFrame(state.sites);
+        RotateOutOfSweepFrame(state.vertices);
+    }
+    if(isSweepComplete && context.reorderForLocality)
+    {
+        ReorderForLocality(context);
+    }
+
+    for(; nextSite<siteCount; nextSite++)
+    {
+        state.unencounteredEvents.emplace_back(GetSiteEvent(context, nextSite));
+    }
+    while(!context.eventQueue.empty())
+    {
+        state.unencounteredEvents.emplace_back(context.events[PopEvent(context)]);
+    }
+    EndSweepPerfPhase(perfCounters, SweepPerfPhase::Finalisation);
+    EndSweepPerfPhase(perfCounters, SweepPerfPhase::Sweep);
+    return state;
+}
+
+// NOTE: Computes the diagram into the context's state, reusing whatever capacity the context
+//       already has. The returned state stays valid until the next run with the same context.
+const FortuneState& FortunesAlgorithm(FortuneContext& context, const std::vector<Vector2>& sites, float cutoffY)
+{
+    PrepareFortuneSites(context, sites);
+    return RunFortuneSweep(context, cutoffY);
+}
+
+FortuneState FortunesAlgorithm(std::vector<Vector2>& sites, float cutoffY)
+{
+    FortuneContext context;
+    FortunesAlgorithm(context, sites, cutoffY);
+    return std::move(context.state);
+}
 
-        delete nextEvent;
+// NOTE: The Delaunay adjacency of the sites, i.e. which pairs of sites share a Voronoi edge.
+//       The neighbours of site i are neighbours[firstNeighbour[i]] up to (but not including)
+//       neighbours[firstNeighbour[i+1]], sorted by site index.
+struct SiteAdjacency
+{
+    std::vector<uint32_t> firstNeighbour;
+    std::vector<uint32_t> neighbours;
+};
+
+void BuildSiteAdjacency(const FortuneState& state, SiteAdjacency& adjacency)
+{
+    size_t siteCount = state.sites.size();
+    adjacency.firstNeighbour.assign(siteCount + 1, 0);
+    for(const CompleteEdge& edge : state.edges)
+    {
+        adjacency.firstNeighbour[edge.leftSite + 1]++;
+        adjacency.firstNeighbour[edge.rightSite + 1]++;
+    }
+    for(size_t i=0; i<siteCount; i++)
+    {
+        adjacency.firstNeighbour[i+1] += adjacency.firstNeighbour[i];
     }
-    if(eventQueue.empty() || (cutoffY < -200.0f))
+
+    // NOTE: Every pair is added to a scratch region at the end of the array first, and then each
+    //       site's neighbours are sorted and compacted down. Two sites share at most one Voronoi edge,
+    //       but with degenerate input the sweep can split that edge in two, so duplicates are removed.
+    size_t edgeEndCount = adjacency.firstNeighbour[siteCount];
+    adjacency.neighbours.resize(2*edgeEndCount);
+    uint32_t* scratch = adjacency.neighbours.data() + edgeEndCount;
+    std::vector<uint32_t>& fill = adjacency.firstNeighbour;
+    for(const CompleteEdge& edge : state.edges)
     {
-        FinishEdge(root, edges);
-        root = nullptr;
+        scratch[fill[edge.leftSite]++] = edge.rightSite;
+        scratch[fill[edge.rightSite]++] = edge.leftSite;
     }
 
-    FortuneState result;
-    result.sweepY = 0.0f;
-    result.beachlineRoot = root;
-    result.edges = edges;
-    while(!eventQueue.empty())
+    // NOTE: After the fill pass each offset holds the end of its site's range (which is
+    //       also the start of the next site's range), so the ranges are walked in order.
+    uint32_t compactedCount = 0;
+    uint32_t rangeStart = 0;
+    for(size_t i=0; i<siteCount; i++)
     {
-        result.unencounteredEvents.emplace_back(eventQueue.top());
-        eventQueue.pop();
+        uint32_t rangeEnd = fill[i];
+        std::sort(scratch + rangeStart, scratch + rangeEnd);
+        uint32_t* uniqueEnd = std::unique(scratch + rangeStart, scratch + rangeEnd);
+
+        fill[i] = compactedCount;
+        for(uint32_t* neighbour=scratch + rangeStart; neighbour<uniqueEnd; neighbour++)
+        {
+            adjacency.neighbours[compactedCount++] = *neighbour;
+        }
+        rangeStart = rangeEnd;
     }
+    fill[siteCount] = compactedCount;
+    adjacency.neighbours.resize(compactedCount);
+}
+
+// NOTE: Returns the unit direction of the edge when walking from its A end to its B end,
+//       which is well-defined even if neither end is a vertex.
+Vector2 GetEdgeDirection(const FortuneState& state, const CompleteEdge& edge)
+{
+    Vector2 left = state.sites[edge.leftSite];
+    Vector2 right = state.sites[edge.rightSite];
+    Vector2 result = normalize({left.y - right.y, right.x - left.x});
     return result;
 }
 
+// NOTE: Gets a drawable segment for the given edge, with any open rays cut off at rayLength
+void GetEdgeSegment(const FortuneState& state, const CompleteEdge& edge, float rayLength, Vector2& start, Vector2& end)
+{
+    Vector2 direction = GetEdgeDirection(state, edge);
+    if((edge.vertexA != InvalidIndex) && (edge.vertexB != InvalidIndex))
+    {
+        start = state.vertices[edge.vertexA];
+        end = state.vertices[edge.vertexB];
+    }
+    else if(edge.vertexA != InvalidIndex)
+    {
+        start = state.vertices[edge.vertexA];
+        end = {start.x + rayLength*direction.x, start.y + rayLength*direction.y};
+    }
+    else if(edge.vertexB != InvalidIndex)
+    {
+        end = state.vertices[edge.vertexB];
+        start = {end.x - rayLength*direction.x, end.y - rayLength*direction.y};
+    }
+    else
+    {
+        Vector2 left = state.sites[edge.leftSite];
+        Vector2 right = state.sites[edge.rightSite];
+        Vector2 midpoint = {0.5f*(left.x + right.x), 0.5f*(left.y + right.y)};
+        start = {midpoint.x - rayLength*direction.x, midpoint.y - rayLength*direction.y};
+        end = {midpoint.x + rayLength*direction.x, midpoint.y + rayLength*direction.y};
+    }
+}
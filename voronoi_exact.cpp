@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "exactint.cpp"
+
+// NOTE: An integer-coordinate version of the sweep. Every decision it makes (event order, which arc
+//       a new site lands on and whether three arcs converge) is computed exactly with integer
+//       arithmetic, and the vertices are output as exact rationals, so the result is the same
+//       on every platform and compiler. It shares the beachline tree and output edge format with
+//       the float version, but never looks at the float geometry stored in the beachline.
+//
+//       Coordinates must lie in [-ExactCoordinateLimit, ExactCoordinateLimit), which keeps every
+//       quantity that is needed on the common path within 64 bits. The only exception is comparing
+//       the heights of two circle events that are too close to tell apart in double precision,
+//       which falls back to ExactInt.
+const int32_t ExactCoordinateLimit = 1 << 18;
+
+struct IntVector2
+{
+    int32_t x;
+    int32_t y;
+};
+
+// NOTE: The point (x/denominator, y/denominator). denominator is always positive.
+struct ExactVertex
+{
+    int64_t x;
+    int64_t y;
+    int64_t denominator;
+};
+
+struct ExactFortuneState
+{
+    std::vector<IntVector2> sites; // The unique sites that the diagram was computed for
+    std::vector<uint32_t> canonicalSite; // canonicalSite[i] is the index in sites of input site i
+
+    std::vector<ExactVertex> vertices;
+    std::vector<CompleteEdge> edges;
+    Beachline beachline;
+};
+
+// NOTE: The circle through the middle arc's site m and its two neighbours has its centre at
+//       m + (offsetX, offsetY)/denominator, so the bottom of the circle (where the event happens) is at
+//       (centreY - sqrt(offsetX^2 + offsetY^2))/denominator. y is that height rounded to a double, and
+//       is never more than yError away from the exact value. radiusSq is offsetX^2 + offsetY^2 if that
+//       fits in 63 bits, or -1 if it does not.
+struct ExactCircleEvent
+{
+    double y;
+    double yError;
+    int64_t centreX;
+    int64_t centreY;
+    int64_t offsetX;
+    int64_t offsetY;
+    int64_t denominator;
+    int64_t radiusSq;
+    uint32_t squeezedArc;
+    bool isValid;
+};
+
+static ExactInt GetExactCircleRadiusSq(const ExactCircleEvent& evt)
+{
+    ExactInt offsetX = MakeExactInt(evt.offsetX);
+    ExactInt offsetY = MakeExactInt(evt.offsetY);
+    return AddExact(MultiplyExact(offsetX, offsetX), MultiplyExact(offsetY, offsetY));
+}
+
+// NOTE: Returns the sign of (lhs.y - rhs.y) for two events that are too close together to tell apart
+//       in double precision.
+static int CompareExactCircleHeightsWithExactInt(const ExactCircleEvent& lhs, const ExactCircleEvent& rhs)
+{
+    // NOTE: Writing each height as (P - sqrt(Q))/D and multiplying through by both (positive)
+    //       denominators, we want the sign of X - (sqrt(U) - sqrt(V)), where X = P1*D2 - P2*D1,
+    //       U = D2^2*Q1 and V = D1^2*Q2. We get rid of the square roots by squaring twice, keeping
+    //       track of the signs of both sides as we go.
+    ExactInt lhsDenominator = MakeExactInt(lhs.denominator);
+    ExactInt rhsDenominator = MakeExactInt(rhs.denominator);
+    ExactInt x = SubtractExact(MultiplyExact(MakeExactInt(lhs.centreY), rhsDenominator),
+                               MultiplyExact(MakeExactInt(rhs.centreY), lhsDenominator));
+    ExactInt u = MultiplyExact(MultiplyExact(rhsDenominator, rhsDenominator), GetExactCircleRadiusSq(lhs));
+    ExactInt v = MultiplyExact(MultiplyExact(lhsDenominator, lhsDenominator), GetExactCircleRadiusSq(rhs));
+    int xSign = GetExactSign(x);
+    int rootDifferenceSign = CompareExact(u, v);
+
+    if((xSign >= 0) && (rootDifferenceSign <= 0))
+    {
+        return ((xSign == 0) && (rootDifferenceSign == 0)) ? 0 : 1;
+    }
+    if((xSign <= 0) && (rootDifferenceSign >= 0))
+    {
+        return -1;
+    }
+
+    // NOTE: Both sides have the same sign, so compare their squares: X^2 vs U + V - 2*sqrt(UV)
+    ExactInt z = SubtractExact(SubtractExact(MultiplyExact(x, x), u), v);
+    int squareComparison;
+    if(GetExactSign(z) >= 0)
+    {
+        squareComparison = 1;
+    }
+    else
+    {
+        ExactInt fourUV = MultiplyExact(MakeExactInt(4), MultiplyExact(u, v));
+        squareComparison = CompareExact(fourUV, MultiplyExact(z, z));
+    }
+    return (xSign > 0) ? squareComparison : -squareComparison;
+}
+
+// NOTE: Returns the sign of (lhs.y - rhs.y), using the exact heights. This runs for every comparison
+//       in the event heap, so only the common cases are handled here and the rest is left to
+//       CompareExactCircleHeightsWithExactInt.
+static inline int CompareExactCircleHeights(const ExactCircleEvent& lhs, const ExactCircleEvent& rhs)
+{
+    double approxDifference = lhs.y - rhs.y;
+    double errorBound = lhs.yError + rhs.yError;
+    if(approxDifference > errorBound) return 1;
+    if(approxDifference < -errorBound) return -1;
+
+    // NOTE: Degenerate input (e.g. a grid) has whole rows of circle events at exactly the same
+    //       height. Those usually come from congruent triangles of sites, so they have the same
+    //       denominator and centre height and only their radii need comparing.
+    if((lhs.denominator == rhs.denominator) && (lhs.centreY == rhs.centreY) && (lhs.radiusSq >= 0) && (rhs.radiusSq >= 0))
+    {
+        return (lhs.radiusSq < rhs.radiusSq) - (lhs.radiusSq > rhs.radiusSq);
+    }
+    return CompareExactCircleHeightsWithExactInt(lhs, rhs);
+}
+
+// NOTE: Returns the sign of (evt.y - siteY), using the exact height of the event.
+static int CompareExactCircleToSiteHeight(const ExactCircleEvent& evt, int32_t siteY)
+{
+    double approxDifference = evt.y - (double)siteY;
+    if(approxDifference > evt.yError) return 1;
+    if(approxDifference < -evt.yError) return -1;
+
+    // NOTE: evt.y >= siteY iff P - siteY*D >= sqrt(Q)
+    int64_t difference = evt.centreY - (int64_t)siteY*evt.denominator;
+    if(difference < 0) return -1;
+    ExactInt differenceSq = MultiplyExact(MakeExactInt(difference), MakeExactInt(difference));
+    return CompareExact(differenceSq, GetExactCircleRadiusSq(evt));
+}
+
+struct ExactFortuneContext
+{
+    ExactFortuneState state;
+    std::vector<Vector2> floatSites;
+    std::vector<Vector2> uniqueFloatSites;
+    std::vector<SiteHashEntry> siteHashTable;
+    std::vector<uint32_t> siteOrder;
+    uint32_t fingerArc = InvalidIndex; // The arc added by the previous site event (see GetExactActiveArc)
+
+    // The sites on either side of each beachline edge, indexed by beachline item
+    std::vector<uint32_t> edgeLeftSite;
+    std::vector<uint32_t> edgeRightSite;
+
+    std::vector<ExactCircleEvent> events;
+    std::vector<uint32_t> freeEvents;
+    std::vector<uint32_t> eventQueue; // A binary heap of indices into events (see PushExactEvent)
+};
+
+static bool IsExactEventHigher(const ExactFortuneContext& context, uint32_t lhs, uint32_t rhs)
+{
+    return CompareExactCircleHeights(context.events[lhs], context.events[rhs]) > 0;
+}
+
+// NOTE: The event heap is written out here rather than using std::push_heap and std::pop_heap,
+//       because the order in which those return events at exactly the same height differs between
+//       standard libraries. Ties are common (every row of a grid is one), and with our own heap they
+//       always come out in the same order without needing a tie-breaker in the comparison, which
+//       would make every comparison between tied events an unpredictable branch.
+static void PushExactEvent(ExactFortuneContext& context, uint32_t eventIndex)
+{
+    std::vector<uint32_t>& queue = context.eventQueue;
+    uint32_t position = (uint32_t)queue.size();
+    queue.emplace_back(eventIndex);
+    while(position > 0)
+    {
+        uint32_t parent = (position - 1)/2;
+        if(!IsExactEventHigher(context, eventIndex, queue[parent]))
+        {
+            break;
+        }
+        queue[position] = queue[parent];
+        position = parent;
+    }
+    queue[position] = eventIndex;
+}
+
+static uint32_t PopExactEvent(ExactFortuneContext& context)
+{
+    std::vector<uint32_t>& queue = context.eventQueue;
+    assert(!queue.empty());
+    uint32_t result = queue.front();
+    uint32_t lastEvent = queue.back();
+    queue.pop_back();
+    if(queue.empty())
+    {
+        return result;
+    }
+
+    uint32_t count = (uint32_t)queue.size();
+    uint32_t position = 0;
+    while(2*position + 1 < count)
+    {
+        uint32_t child = 2*position + 1;
+        if((child + 1 < count) && IsExactEventHigher(context, queue[child + 1], queue[child]))
+        {
+            child++;
+        }
+        if(!IsExactEventHigher(context, queue[child], lastEvent))
+        {
+            break;
+        }
+        queue[position] = queue[child];
+        position = child;
+    }
+    queue[position] = lastEvent;
+    return result;
+}
+
+// NOTE: Returns true if site p lies to the left of the breakpoint between the arcs of l and r
+//       (in that order along the beachline) when the sweep line is at p.y.
+//       A parabola with focus f and directrix p.y is (x-f.x)^2 + h^2 over 2h above the directrix at x,
+//       where h = f.y - p.y. Two parabolas cross twice: the wider one (larger h) is lower outside
+//       the two crossings, and the narrower one is lower between them (which includes its focus x).
+//       Which of the two crossings is the breakpoint depends on which of l and r is the wider one.
+static bool IsLeftOfExactBreakpoint(IntVector2 p, IntVector2 l, IntVector2 r)
+{
+    int64_t leftHeight = (int64_t)l.y - p.y;
+    int64_t rightHeight = (int64_t)r.y - p.y;
+    assert((leftHeight >= 0) && (rightHeight >= 0));
+    if(leftHeight == 0)
+    {
+        return p.x < l.x;
+    }
+    if(rightHeight == 0)
+    {
+        return p.x < r.x;
+    }
+    if(leftHeight == rightHeight)
+    {
+        return 2*(int64_t)p.x < (int64_t)l.x + (int64_t)r.x;
+    }
+
+    int64_t leftOffset = (int64_t)p.x - l.x;
+    int64_t rightOffset = (int64_t)p.x - r.x;
+    int64_t leftArcHeight = (leftOffset*leftOffset + leftHeight*leftHeight)*rightHeight;
+    int64_t rightArcHeight = (rightOffset*rightOffset + rightHeight*rightHeight)*leftHeight;
+    bool isLeftArcLower = (leftArcHeight < rightArcHeight);
+    if(leftHeight > rightHeight)
+    {
+        // The breakpoint is the left crossing, which is left of r.x
+        return isLeftArcLower && (p.x < r.x);
+    }
+    else
+    {
+        // The breakpoint is the right crossing, which is right of l.x
+        return isLeftArcLower || (p.x <= l.x);
+    }
+}
+
+// NOTE: Descends from any item in the tree to the arc in its subtree that is above p, assuming that
+//       p is somewhere within the range covered by that subtree.
+static uint32_t GetExactActiveArcInSubtree(const ExactFortuneContext& context, uint32_t subtreeRoot, IntVector2 p)
+{
+    const Beachline& beachline = context.state.beachline;
+    const std::vector<IntVector2>& sites = context.state.sites;
+    uint32_t current = subtreeRoot;
+    while(beachline.type[current] == BeachlineItemType::Edge)
+    {
+        IntVector2 leftSite = sites[context.edgeLeftSite[current]];
+        IntVector2 rightSite = sites[context.edgeRightSite[current]];
+        if(IsLeftOfExactBreakpoint(p, leftSite, rightSite))
+        {
+            current = beachline.left[current];
+        }
+        else
+        {
+            current = beachline.right[current];
+        }
+    }
+    return current;
+}
+
+static bool IsLeftOfExactEdge(const ExactFortuneContext& context, IntVector2 p, uint32_t edge)
+{
+    const std::vector<IntVector2>& sites = context.state.sites;
+    return IsLeftOfExactBreakpoint(p, sites[context.edgeLeftSite[edge]], sites[context.edgeRightSite[edge]]);
+}
+
+// NOTE: The same finger search as GetActiveArcFromFinger, starting from the arc of the previous site
+//       and walking up through the edges that bound it until one of them is beyond p.
+static uint32_t GetExactActiveArc(const ExactFortuneContext& context, IntVector2 p)
+{
+    const Beachline& beachline = context.state.beachline;
+    uint32_t finger = context.fingerArc;
+    if((finger == InvalidIndex) || (beachline.type[finger] != BeachlineItemType::Arc))
+    {
+        return GetExactActiveArcInSubtree(context, beachline.root, p);
+    }
+
+    uint32_t boundary = GetFirstParentOnTheLeft(beachline, finger);
+    if((boundary != InvalidIndex) && IsLeftOfExactEdge(context, p, boundary))
+    {
+        for(uint32_t step=0; step<MaxFingerSearchSteps; step++)
+        {
+            uint32_t next = GetFirstParentOnTheLeft(beachline, boundary);
+            if((next == InvalidIndex) || !IsLeftOfExactEdge(context, p, next))
+            {
+                return GetExactActiveArcInSubtree(context, beachline.left[boundary], p);
+            }
+            boundary = next;
+        }
+        return GetExactActiveArcInSubtree(context, beachline.root, p);
+    }
+
+    boundary = GetFirstParentOnTheRight(beachline, finger);
+    if((boundary != InvalidIndex) && !IsLeftOfExactEdge(context, p, boundary))
+    {
+        for(uint32_t step=0; step<MaxFingerSearchSteps; step++)
+        {
+            uint32_t next = GetFirstParentOnTheRight(beachline, boundary);
+            if((next == InvalidIndex) || IsLeftOfExactEdge(context, p, next))
+            {
+                return GetExactActiveArcInSubtree(context, beachline.right[boundary], p);
+            }
+            boundary = next;
+        }
+        return GetExactActiveArcInSubtree(context, beachline.root, p);
+    }
+    return finger;
+}
+
+static uint32_t CreateExactArc(ExactFortuneContext& context, uint32_t site)
+{
+    Beachline& beachline = context.state.beachline;
+    uint32_t result = AllocateBeachlineItem(beachline, BeachlineItemType::Arc);
+    beachline.site[result] = site;
+    beachline.point[result] = {(float)context.state.sites[site].x, (float)context.state.sites[site].y};
+    return result;
+}
+
+static uint32_t CreateExactEdge(ExactFortuneContext& context, uint32_t leftSite, uint32_t rightSite)
+{
+    uint32_t result = AllocateBeachlineItem(context.state.beachline, BeachlineItemType::Edge);
+    if(result >= context.edgeLeftSite.size())
+    {
+        context.edgeLeftSite.resize(result+1);
+        context.edgeRightSite.resize(result+1);
+    }
+    context.edgeLeftSite[result] = leftSite;
+    context.edgeRightSite[result] = rightSite;
+    return result;
+}
+
+// NOTE: Output edges follow the same conventions as the float version (see StartOutputEdge), but
+//       the sites on either side come straight from the beachline edge.
+static void StartExactOutputEdge(ExactFortuneContext& context, uint32_t beachlineEdge, uint32_t vertexA)
+{
+    Beachline& beachline = context.state.beachline;
+    CompleteEdge edge;
+    edge.vertexA = vertexA;
+    edge.vertexB = InvalidIndex;
+    edge.leftSite = context.edgeRightSite[beachlineEdge];
+    edge.rightSite = context.edgeLeftSite[beachlineEdge];
+
+    beachline.outputEdge[beachlineEdge] = (uint32_t)context.state.edges.size();
+    beachline.finishesAtVertexA[beachlineEdge] = false;
+    context.state.edges.emplace_back(edge);
+}
+
+static void FinishExactOutputEdge(ExactFortuneContext& context, uint32_t beachlineEdge, uint32_t vertex)
+{
+    const Beachline& beachline = context.state.beachline;
+    CompleteEdge& edge = context.state.edges[beachline.outputEdge[beachlineEdge]];
+    if(beachline.finishesAtVertexA[beachlineEdge])
+    {
+        assert(edge.vertexA == InvalidIndex);
+        edge.vertexA = vertex;
+    }
+    else
+    {
+        assert(edge.vertexB == InvalidIndex);
+        edge.vertexB = vertex;
+    }
+}
+
+static void InvalidateExactSqueezeEvent(ExactFortuneContext& context, uint32_t arc)
+{
+    Beachline& beachline = context.state.beachline;
+    uint32_t existingEvent = beachline.squeezeEvent[arc];
+    if(existingEvent != InvalidIndex)
+    {
+        context.events[existingEvent].isValid = false;
+        beachline.squeezeEvent[arc] = InvalidIndex;
+    }
+}
+
+// NOTE: Any event that the arc already had was for a different pair of neighbours, so it is always
+//       replaced. The arc is only squeezed out if its neighbours turn clockwise around it (when
+//       walking along the beachline), in which case the two edges on either side of it converge.
+static void AddExactArcSqueezeEvent(ExactFortuneContext& context, uint32_t arc)
+{
+    Beachline& beachline = context.state.beachline;
+    InvalidateExactSqueezeEvent(context, arc);
+
+    uint32_t leftEdge = GetFirstParentOnTheLeft(beachline, arc);
+    uint32_t rightEdge = GetFirstParentOnTheRight(beachline, arc);
+    if((leftEdge == InvalidIndex) || (rightEdge == InvalidIndex))
+    {
+        return;
+    }
+
+    IntVector2 middle = context.state.sites[beachline.site[arc]];
+    IntVector2 left = context.state.sites[context.edgeLeftSite[leftEdge]];
+    IntVector2 right = context.state.sites[context.edgeRightSite[rightEdge]];
+    int64_t leftX = (int64_t)left.x - middle.x;
+    int64_t leftY = (int64_t)left.y - middle.y;
+    int64_t rightX = (int64_t)right.x - middle.x;
+    int64_t rightY = (int64_t)right.y - middle.y;
+    int64_t denominator = 2*(leftX*rightY - leftY*rightX);
+    if(denominator <= 0)
+    {
+        return;
+    }
+
+    int64_t leftLengthSq = leftX*leftX + leftY*leftY;
+    int64_t rightLengthSq = rightX*rightX + rightY*rightY;
+    ExactCircleEvent newEvt;
+    newEvt.offsetX = rightY*leftLengthSq - leftY*rightLengthSq;
+    newEvt.offsetY = leftX*rightLengthSq - rightX*leftLengthSq;
+    newEvt.denominator = denominator;
+    newEvt.centreX = (int64_t)middle.x*denominator + newEvt.offsetX;
+    newEvt.centreY = (int64_t)middle.y*denominator + newEvt.offsetY;
+    const int64_t smallOffsetLimit = (int64_t)1 << 31;
+    bool isSmallCircle = (newEvt.offsetX > -smallOffsetLimit) && (newEvt.offsetX < smallOffsetLimit) &&
+                         (newEvt.offsetY > -smallOffsetLimit) && (newEvt.offsetY < smallOffsetLimit);
+    newEvt.radiusSq = isSmallCircle ? (newEvt.offsetX*newEvt.offsetX + newEvt.offsetY*newEvt.offsetY) : -1;
+
+    // NOTE: Every step of computing y rounds to within half an ulp, and the subtraction can cancel,
+    //       so bound the error relative to the size of the operands rather than the result.
+    double offsetX = (double)newEvt.offsetX;
+    double offsetY = (double)newEvt.offsetY;
+    double radius = sqrt(offsetX*offsetX + offsetY*offsetY);
+    double centreY = (double)newEvt.centreY;
+    newEvt.y = (centreY - radius)/(double)denominator;
+    newEvt.yError = 4.0*DBL_EPSILON*(fabs(centreY) + radius)/(double)denominator;
+    newEvt.squeezedArc = arc;
+    newEvt.isValid = true;
+
+    uint32_t eventIndex;
+    if(!context.freeEvents.empty())
+    {
+        eventIndex = context.freeEvents.back();
+        context.freeEvents.pop_back();
+        context.events[eventIndex] = newEvt;
+    }
+    else
+    {
+        eventIndex = (uint32_t)context.events.size();
+        context.events.emplace_back(newEvt);
+    }
+    PushExactEvent(context, eventIndex);
+    beachline.squeezeEvent[arc] = eventIndex;
+}
+
+static void AddExactArcToBeachline(ExactFortuneContext& context, uint32_t newSite)
+{
+    Beachline& beachline = context.state.beachline;
+    uint32_t replacedArc = GetExactActiveArc(context, context.state.sites[newSite]);
+    uint32_t replacedSite = beachline.site[replacedArc];
+    InvalidateExactSqueezeEvent(context, replacedArc);
+
+    uint32_t splitArcLeft = CreateExactArc(context, replacedSite);
+    uint32_t splitArcRight = CreateExactArc(context, replacedSite);
+    uint32_t newArc = CreateExactArc(context, newSite);
+    context.fingerArc = newArc;
+    uint32_t edgeLeft = CreateExactEdge(context, replacedSite, newSite);
+    uint32_t edgeRight = CreateExactEdge(context, newSite, replacedSite);
+
+    SetBeachlineParentFromItem(beachline, edgeLeft, replacedArc);
+    SetBeachlineLeft(beachline, edgeLeft, splitArcLeft);
+    SetBeachlineRight(beachline, edgeLeft, edgeRight);
+    SetBeachlineLeft(beachline, edgeRight, newArc);
+    SetBeachlineRight(beachline, edgeRight, splitArcRight);
+    if(beachline.root == replacedArc)
+    {
+        beachline.root = edgeLeft;
+    }
+
+    StartExactOutputEdge(context, edgeLeft, InvalidIndex);
+    beachline.outputEdge[edgeRight] = beachline.outputEdge[edgeLeft];
+    beachline.finishesAtVertexA[edgeRight] = true;
+
+    FreeBeachlineItem(beachline, replacedArc);
+    AddExactArcSqueezeEvent(context, splitArcLeft);
+    AddExactArcSqueezeEvent(context, splitArcRight);
+}
+
+static void RemoveExactArcFromBeachline(ExactFortuneContext& context, uint32_t eventIndex)
+{
+    Beachline& beachline = context.state.beachline;
+    const ExactCircleEvent& evt = context.events[eventIndex];
+    uint32_t squeezedArc = evt.squeezedArc;
+    assert(evt.isValid && (beachline.squeezeEvent[squeezedArc] == eventIndex));
+
+    uint32_t leftEdge = GetFirstParentOnTheLeft(beachline, squeezedArc);
+    uint32_t rightEdge = GetFirstParentOnTheRight(beachline, squeezedArc);
+    uint32_t leftArc = GetFirstLeafOnTheLeft(beachline, leftEdge);
+    uint32_t rightArc = GetFirstLeafOnTheRight(beachline, rightEdge);
+    assert((leftArc != InvalidIndex) && (rightArc != InvalidIndex) && (leftArc != rightArc));
+
+    uint32_t circleVertex = (uint32_t)context.state.vertices.size();
+    ExactVertex vertex = {evt.centreX, evt.centreY, evt.denominator};
+    context.state.vertices.emplace_back(vertex);
+    FinishExactOutputEdge(context, leftEdge, circleVertex);
+    FinishExactOutputEdge(context, rightEdge, circleVertex);
+
+    uint32_t newItem = CreateExactEdge(context, beachline.site[leftArc], beachline.site[rightArc]);
+
+    // NOTE: Both edges are ancestors of the squeezed arc and one of them is its parent, so the other
+    //       one is higher up the tree. There is no need to walk up to the root to find out which.
+    uint32_t parent = beachline.parent[squeezedArc];
+    assert((parent == leftEdge) || (parent == rightEdge));
+    uint32_t higherEdge = (parent == leftEdge) ? rightEdge : leftEdge;
+
+    SetBeachlineParentFromItem(beachline, newItem, higherEdge);
+    SetBeachlineLeft(beachline, newItem, beachline.left[higherEdge]);
+    SetBeachlineRight(beachline, newItem, beachline.right[higherEdge]);
+
+    uint32_t remainingItem = (beachline.left[parent] == squeezedArc) ? beachline.right[parent] : beachline.left[parent];
+    SetBeachlineParentFromItem(beachline, remainingItem, parent);
+
+    if((beachline.root == leftEdge) || (beachline.root == rightEdge))
+    {
+        beachline.root = newItem;
+    }
+    StartExactOutputEdge(context, newItem, circleVertex);
+
+    beachline.squeezeEvent[squeezedArc] = InvalidIndex;
+    FreeBeachlineItem(beachline, leftEdge);
+    FreeBeachlineItem(beachline, squeezedArc);
+    FreeBeachlineItem(beachline, rightEdge);
+
+    AddExactArcSqueezeEvent(context, leftArc);
+    AddExactArcSqueezeEvent(context, rightArc);
+}
+
+// NOTE: Builds a balanced beachline for the sites siteOrder[begin] up to (but not including)
+//       siteOrder[end], which must all be at the same height, as BuildStartupBeachline does.
+//       Returns the root of the subtree and outputs its rightmost arc.
+static uint32_t BuildExactStartupBeachline(ExactFortuneContext& context, uint32_t begin, uint32_t end, uint32_t& rightmostArc)
+{
+    Beachline& beachline = context.state.beachline;
+    if(end - begin == 1)
+    {
+        rightmostArc = CreateExactArc(context, context.siteOrder[begin]);
+        return rightmostArc;
+    }
+
+    uint32_t middle = begin + (end - begin)/2;
+    uint32_t leftArc;
+    uint32_t leftRoot = BuildExactStartupBeachline(context, begin, middle, leftArc);
+    uint32_t edge = CreateExactEdge(context, beachline.site[leftArc], context.siteOrder[middle]);
+    StartExactOutputEdge(context, edge, InvalidIndex);
+    uint32_t rightRoot = BuildExactStartupBeachline(context, middle, end, rightmostArc);
+    SetBeachlineLeft(beachline, edge, leftRoot);
+    SetBeachlineRight(beachline, edge, rightRoot);
+    return edge;
+}
+
+// NOTE: Computes the diagram of the given integer sites. Exact duplicates are merged, and as with
+//       the float version the returned state stays valid until the next run with the same context.
+const ExactFortuneState& FortunesAlgorithmExact(ExactFortuneContext& context, const std::vector<IntVector2>& sites)
+{
+    TRACE_SCOPE("Exact sweep");
+    ExactFortuneState& state = context.state;
+    Beachline& beachline = state.beachline;
+    ClearBeachline(beachline);
+    state.vertices.clear();
+    state.edges.clear();
+    context.events.clear();
+    context.freeEvents.clear();
+    context.eventQueue.clear();
+
+    // NOTE: Every coordinate in range is exactly representable as a float, so we can reuse the
+    //       float deduplication with a tolerance of zero.
+    context.floatSites.resize(sites.size());
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        assert((sites[i].x >= -ExactCoordinateLimit) && (sites[i].x < ExactCoordinateLimit));
+        assert((sites[i].y >= -ExactCoordinateLimit) && (sites[i].y < ExactCoordinateLimit));
+        context.floatSites[i] = {(float)sites[i].x, (float)sites[i].y};
+    }
+    DeduplicateSites(context.floatSites, 0.0f, context.uniqueFloatSites, state.canonicalSite, context.siteHashTable);
+    state.sites.resize(context.uniqueFloatSites.size());
+    for(size_t i=0; i<sites.size(); i++)
+    {
+        state.sites[state.canonicalSite[i]] = sites[i];
+    }
+
+    uint32_t siteCount = (uint32_t)state.sites.size();
+    context.siteOrder.resize(siteCount);
+    for(uint32_t i=0; i<siteCount; i++)
+    {
+        context.siteOrder[i] = i;
+    }
+    const IntVector2* sitePositions = state.sites.data();
+    std::sort(context.siteOrder.begin(), context.siteOrder.end(), [sitePositions](uint32_t lhs, uint32_t rhs)
+    {
+        IntVector2 l = sitePositions[lhs];
+        IntVector2 r = sitePositions[rhs];
+        if(l.y != r.y) return l.y > r.y;
+        return l.x < r.x;
+    });
+    if(siteCount == 0)
+    {
+        return state;
+    }
+
+    // NOTE: Sites at the same height as the first one have nothing to land on but vertical arcs, so
+    //       (since they come in order of x) the whole row goes straight into a balanced tree.
+    int32_t firstY = state.sites[context.siteOrder[0]].y;
+    uint32_t nextSite = 1;
+    while((nextSite < siteCount) && (state.sites[context.siteOrder[nextSite]].y == firstY))
+    {
+        nextSite++;
+    }
+    beachline.root = BuildExactStartupBeachline(context, 0, nextSite, context.fingerArc);
+
+    while((nextSite < siteCount) || !context.eventQueue.empty())
+    {
+        // NOTE: When a site and a circle event are at the same height, the circle event goes first
+        bool isSiteNext = (nextSite < siteCount);
+        if(isSiteNext && !context.eventQueue.empty())
+        {
+            const ExactCircleEvent& nextCircle = context.events[context.eventQueue.front()];
+            isSiteNext = (CompareExactCircleToSiteHeight(nextCircle, state.sites[context.siteOrder[nextSite]].y) < 0);
+        }
+
+        if(isSiteNext)
+        {
+            AddExactArcToBeachline(context, context.siteOrder[nextSite]);
+            nextSite++;
+            continue;
+        }
+
+        uint32_t nextEvent = PopExactEvent(context);
+        if(context.events[nextEvent].isValid)
+        {
+            RemoveExactArcFromBeachline(context, nextEvent);
+        }
+        context.freeEvents.emplace_back(nextEvent);
+    }
+    ClearBeachline(beachline);
+    return state;
+}
+
+static Vector2 GetExactVertexPosition(const ExactVertex& vertex)
+{
+    Vector2 result = {(float)((double)vertex.x/(double)vertex.denominator),
+                      (float)((double)vertex.y/(double)vertex.denominator)};
+    return result;
+}
+
+// NOTE: Rounds an exact diagram to floats, so that it can be used with everything that consumes
+//       a FortuneState (drawing, adjacency, clipped cells, etc).
+void ConvertExactDiagram(const ExactFortuneState& exact, FortuneState& result)
+{
+    result.sites.resize(exact.sites.size());
+    for(size_t i=0; i<exact.sites.size(); i++)
+    {
+        result.sites[i] = {(float)exact.sites[i].x, (float)exact.sites[i].y};
+    }
+    result.canonicalSite = exact.canonicalSite;
+    result.vertices.resize(exact.vertices.size());
+    for(size_t i=0; i<exact.vertices.size(); i++)
+    {
+        result.vertices[i] = GetExactVertexPosition(exact.vertices[i]);
+    }
+    result.edges = exact.edges;
+    result.unencounteredEvents.clear();
+    result.sweepY = -FLT_MAX;
+    ClearBeachline(result.beachline);
+}
@@ -1,76 +1,167 @@
-static BeachlineItem* GetFirstParentOnTheLeft(BeachlineItem* item)
+static uint32_t GetFirstParentOnTheLeft(const Beachline& beachline, uint32_t item)
 {
-    BeachlineItem* current = item;
-    while((current->parent != nullptr) && (current->parent->left == current))
+    uint32_t current = item;
+    while((beachline.parent[current] != InvalidIndex) && (beachline.left[beachline.parent[current]] == current))
     {
-        current = current->parent;
+        current = beachline.parent[current];
     }
-    assert((current->parent == nullptr) || (current->parent->type == BeachlineItemType::Edge));
-    return current->parent;
+    assert((beachline.parent[current] == InvalidIndex) || (beachline.type[beachline.parent[current]] == BeachlineItemType::Edge));
+    return beachline.parent[current];
 }
-static BeachlineItem* GetFirstParentOnTheRight(BeachlineItem* item)
+static uint32_t GetFirstParentOnTheRight(const Beachline& beachline, uint32_t item)
 {
-    BeachlineItem* current = item;
-    while((current->parent != nullptr) && (current->parent->right == current))
+    uint32_t current = item;
+    while((beachline.parent[current] != InvalidIndex) && (beachline.right[beachline.parent[current]] == current))
     {
-        current = current->parent;
+        current = beachline.parent[current];
     }
-    assert((current->parent == nullptr) || (current->parent->type == BeachlineItemType::Edge));
-    return current->parent;
+    assert((beachline.parent[current] == InvalidIndex) || (beachline.type[beachline.parent[current]] == BeachlineItemType::Edge));
+    return beachline.parent[current];
 }
-static BeachlineItem* GetFirstLeafOnTheLeft(BeachlineItem* item)
+static uint32_t GetFirstLeafOnTheLeft(const Beachline& beachline, uint32_t item)
 {
-    if(item->left == nullptr)
+    if(beachline.left[item] == InvalidIndex)
     {
-        return nullptr;
+        return InvalidIndex;
     }
-    BeachlineItem* current = item->left;
-    while(current->right != nullptr)
+    uint32_t current = beachline.left[item];
+    while(beachline.right[current] != InvalidIndex)
     {
-        current = current->right;
+        current = beachline.right[current];
     }
-    assert(current->type == BeachlineItemType::Arc);
+    assert(beachline.type[current] == BeachlineItemType::Arc);
     return current;
 }
-static BeachlineItem* GetFirstLeafOnTheRight(BeachlineItem* item)
+static uint32_t GetFirstLeafOnTheRight(const Beachline& beachline, uint32_t item)
 {
-    if(item->right == nullptr)
+    if(beachline.right[item] == InvalidIndex)
     {
-        return nullptr;
+        return InvalidIndex;
     }
-    BeachlineItem* current = item->right;
-    while(current->left != nullptr)
+    uint32_t current = beachline.right[item];
+    while(beachline.left[current] != InvalidIndex)
     {
-        current = current->left;
+        current = beachline.left[current];
     }
-    assert(current->type == BeachlineItemType::Arc);
+    assert(beachline.type[current] == BeachlineItemType::Arc);
     return current;
 }
 
-static void DeleteBeachlineItem(BeachlineItem* item)
+static uint32_t AllocateBeachlineItem(Beachline& beachline, BeachlineItemType type)
 {
-    if(item == nullptr) return;
-    DeleteBeachlineItem(item->left);
-    DeleteBeachlineItem(item->right);
-    delete item;
+    uint32_t result;
+    if(!beachline.freeItems.empty())
+    {
+        result = beachline.freeItems.back();
+        beachline.freeItems.pop_back();
+    }
+    else
+    {
+        result = (uint32_t)beachline.type.size();
+        beachline.type.emplace_back();
+        beachline.point.emplace_back();
+        beachline.direction.emplace_back();
+        beachline.parent.emplace_back();
+        beachline.left.emplace_back();
+        beachline.right.emplace_back();
+        beachline.squeezeEvent.emplace_back();
+        beachline.site.emplace_back();
+        beachline.outputEdge.emplace_back();
+        beachline.finishesAtVertexA.emplace_back();
+    }
+
+    beachline.type[result] = type;
+    beachline.point[result] = {};
+    beachline.direction[result] = {};
+    beachline.parent[result] = InvalidIndex;
+    beachline.left[result] = InvalidIndex;
+    beachline.right[result] = InvalidIndex;
+    beachline.squeezeEvent[result] = InvalidIndex;
+    beachline.site[result] = InvalidIndex;
+    beachline.outputEdge[result] = InvalidIndex;
+    beachline.finishesAtVertexA[result] = false;
+    return result;
+}
+
+static void FreeBeachlineItem(Beachline& beachline, uint32_t item)
+{
+    assert(beachline.type[item] != BeachlineItemType::None);
+    beachline.type[item] = BeachlineItemType::None;
+    beachline.freeItems.emplace_back(item);
+}
+
+static void SetBeachlineLeft(Beachline& beachline, uint32_t item, uint32_t newLeft)
+{
+    assert(beachline.type[item] == BeachlineItemType::Edge);
+    assert(newLeft != InvalidIndex);
+    beachline.left[item] = newLeft;
+    beachline.parent[newLeft] = item;
+}
+
+static void SetBeachlineRight(Beachline& beachline, uint32_t item, uint32_t newRight)
+{
+    assert(beachline.type[item] == BeachlineItemType::Edge);
+    assert(newRight != InvalidIndex);
+    beachline.right[item] = newRight;
+    beachline.parent[newRight] = item;
+}
+
+// NOTE: Puts newItem into the position in the tree that is currently occupied by oldItem
+static void SetBeachlineParentFromItem(Beachline& beachline, uint32_t newItem, uint32_t oldItem)
+{
+    assert(oldItem != InvalidIndex);
+    uint32_t oldParent = beachline.parent[oldItem];
+    if(oldParent == InvalidIndex)
+    {
+        beachline.parent[newItem] = InvalidIndex;
+        return;
+    }
+
+    if(beachline.left[oldParent] == oldItem)
+    {
+        SetBeachlineLeft(beachline, oldParent, newItem);
+    }
+    else
+    {
+        assert(beachline.right[oldParent] == oldItem);
+        SetBeachlineRight(beachline, oldParent, newItem);
+    }
+}
+
+static void ClearBeachline(Beachline& beachline)
+{
+    beachline.type.clear();
+    beachline.point.clear();
+    beachline.direction.clear();
+    beachline.parent.clear();
+    beachline.left.clear();
+    beachline.right.clear();
+    beachline.squeezeEvent.clear();
+    beachline.site.clear();
+    beachline.outputEdge.clear();
+    beachline.finishesAtVertexA.clear();
+    beachline.freeItems.clear();
+    beachline.root = InvalidIndex;
 }
 
-static int CountBeachlineItems(BeachlineItem* root)
+static int CountBeachlineItems(const Beachline& beachline, uint32_t root)
 {
-    if(root == nullptr) return 0;
-    int left = CountBeachlineItems(root->left);
-    int right = CountBeachlineItems(root->right);
+    if(root == InvalidIndex) return 0;
+    int left = CountBeachlineItems(beachline, beachline.left[root]);
+    int right = CountBeachlineItems(beachline, beachline.right[root]);
     return left + right + 1;
 }
-static void VerifyThatThereAreNoReferencesToItem(BeachlineItem* root, BeachlineItem* item)
+static void VerifyThatThereAreNoReferencesToItem(const Beachline& beachline, uint32_t root, uint32_t item)
 {
-    if(root == nullptr) return;
-    if(root->type == BeachlineItemType::Arc) return;
+#ifndef NDEBUG
+    if(root == InvalidIndex) return;
+    if(beachline.type[root] == BeachlineItemType::Arc) return;
 
-    assert(root->parent != item);
-    assert(root->left != item);
-    assert(root->right != item);
+    assert(beachline.parent[root] != item);
+    assert(beachline.left[root] != item);
+    assert(beachline.right[root] != item);
 
-    VerifyThatThereAreNoReferencesToItem(root->left, item);
-    VerifyThatThereAreNoReferencesToItem(root->right, item);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.left[root], item);
+    VerifyThatThereAreNoReferencesToItem(beachline, beachline.right[root], item);
+#endif
 }